@@ -27,6 +27,7 @@
 #include <flash/nor/core.h>
 #include <flash/nor/imp.h>
 #include <target/image.h>
+#include <target/mem_cache.h>
 
 /**
  * @file
@@ -43,6 +44,7 @@ int flash_driver_erase(struct flash_bank *bank, unsigned int first,
 	int retval;
 
 	retval = bank->driver->erase(bank, first, last);
+	target_mem_cache_invalidate(bank->target);
 	if (retval != ERROR_OK)
 		LOG_ERROR("failed erasing sectors %u to %u", first, last);
 
@@ -99,6 +101,7 @@ int flash_driver_write(struct flash_bank *bank,
 	int retval;
 
 	retval = bank->driver->write(bank, buffer, offset, count);
+	target_mem_cache_invalidate(bank->target);
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
 			"error writing to flash at address " TARGET_ADDR_FMT
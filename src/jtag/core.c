@@ -1088,6 +1088,13 @@ int jtag_get_flush_queue_count(void)
 	return jtag_flush_queue_count;
 }
 
+unsigned jtag_get_queue_depth(void)
+{
+	if (!jtag || !jtag->jtag_ops || !jtag->jtag_ops->queue_depth)
+		return 0;
+	return jtag->jtag_ops->queue_depth();
+}
+
 int jtag_execute_queue(void)
 {
 	jtag_execute_queue_noclear();
@@ -40,6 +40,8 @@
 #include "c_jtag_client_gnuaji_lib64.h"
 #endif
 
+#include "c_jtag_client_gnuaji_mock.h"
+
 const char* c_aji_error_decode(AJI_ERROR code);
 
 
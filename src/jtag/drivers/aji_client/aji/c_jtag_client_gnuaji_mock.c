@@ -0,0 +1,1202 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Intel Corporation                               *
+ *   SPDX-License-Identifier: GPL-2.0-or-later                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#if BUILD_AJI_CLIENT_MOCK
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "replacements.h"
+#include "log.h"
+#include "c_aji.h"
+#include "c_jtag_client_gnuaji.h"
+#include "c_jtag_client_gnuaji_mock.h"
+
+/**
+ * C AJI functions, simulated.
+ *
+ * Implements every function in c_jtag_client_gnuaji.h without a
+ * JTAG server, @see c_jtag_client_gnuaji_mock.h for the model.
+ */
+
+#define C_AJI_MOCK_PERSISTENT_ID 1
+#define C_AJI_MOCK_HUB_IDCODE    0x08086E04
+#define C_AJI_MOCK_NO_NODE       UINT32_MAX
+
+// ADIv5 JTAG-DP, @see c_aji_mock_add_dap()
+#define C_AJI_MOCK_DAP_IRLEN      4
+#define C_AJI_MOCK_DAP_IR_ABORT   0x8
+#define C_AJI_MOCK_DAP_IR_DPACC   0xA
+#define C_AJI_MOCK_DAP_IR_APACC   0xB
+#define C_AJI_MOCK_DAP_DR_LENGTH  35
+#define C_AJI_MOCK_DAP_ACK_OK     0x2
+
+#define C_AJI_MOCK_DP_CTRL_STAT   0x4
+#define C_AJI_MOCK_DP_SELECT      0x8
+#define C_AJI_MOCK_DP_RDBUFF      0xC
+#define C_AJI_MOCK_DP_PWRUP_REQ   0x54000000 //< CSYSPWRUPREQ, CDBGPWRUPREQ, CDBGRSTREQ
+#define C_AJI_MOCK_DP_CTRL_RW     (C_AJI_MOCK_DP_PWRUP_REQ | 0x00000F0D)
+
+#define C_AJI_MOCK_AP_CSW         0x00
+#define C_AJI_MOCK_AP_TAR         0x04
+#define C_AJI_MOCK_AP_DRW         0x0C
+#define C_AJI_MOCK_AP_BD0         0x10
+#define C_AJI_MOCK_AP_BD3         0x1C
+#define C_AJI_MOCK_AP_BASE        0xF8
+#define C_AJI_MOCK_AP_IDR         0xFC
+#define C_AJI_MOCK_AP_IDR_AHB_AP  0x24770011
+#define C_AJI_MOCK_AP_BASE_NONE   0xFFFFFFFF //< No ROM table
+
+#define C_AJI_MOCK_CSW_SIZE       0x00000007
+#define C_AJI_MOCK_CSW_ADDRINC    0x00000030
+#define C_AJI_MOCK_CSW_SINGLE     0x00000010
+#define C_AJI_MOCK_CSW_PACKED     0x00000020
+#define C_AJI_MOCK_CSW_DEVICE_EN  0x00000040
+#define C_AJI_MOCK_CSW_TR_IN_PROG 0x00000080
+#define C_AJI_MOCK_TAR_WRAP       0x000003FF //< TAR auto-increment wraps at 1KB
+
+// AJI_CHAIN is opaque to the AJI client, so the mock gets to define it
+struct AJI_CHAIN {
+    bool locked;
+};
+
+struct c_aji_mock_register {
+    BYTE *bits;
+    DWORD size; //< in bytes
+};
+
+struct c_aji_mock_node {
+    DWORD idcode;
+    DWORD overlay;
+    struct c_aji_mock_register dr;
+};
+
+struct c_aji_mock_dap {
+    BYTE *memory;
+    DWORD memory_size; //< in bytes
+    DWORD ctrl_stat;
+    DWORD select;
+    DWORD read_result; //< captured by the next DPACC/APACC scan
+    DWORD csw;
+    DWORD tar;
+};
+
+struct c_aji_mock_tap {
+    DWORD idcode;
+    DWORD irlen;
+    QWORD ir;
+    struct c_aji_mock_register dr;
+    struct c_aji_mock_dap *dap; //< NULL unless the TAP is a JTAG-DP
+    DWORD node_count;
+    struct c_aji_mock_node nodes[C_AJI_MOCK_MAX_NODES];
+};
+
+struct c_aji_mock_open {
+    struct c_aji_mock_open *next;
+    DWORD tap_position;
+    DWORD node_position; //< C_AJI_MOCK_NO_NODE if the TAP itself is opened
+};
+
+/**
+ * Captured data waiting for c_aji_flush() to be delivered.
+ * Exactly one of read_bits and read_dword is set.
+ */
+struct c_aji_mock_capture {
+    BYTE *read_bits;
+    DWORD *read_dword;
+    DWORD bit_count;
+    BYTE data[];
+};
+
+static struct {
+    struct AJI_CHAIN chain;
+    DWORD tap_count;
+    struct c_aji_mock_tap taps[C_AJI_MOCK_MAX_TAPS];
+
+    struct c_aji_mock_open *opens;
+    struct c_aji_mock_open *locked;
+    AJI_PACK_STYLE pack_style;
+
+    struct c_aji_mock_capture **pending;
+    DWORD pending_count;
+    DWORD pending_size;
+    DWORD pending_delay_us;
+    enum c_aji_mock_state state;
+
+    DWORD latency_us;
+    struct c_aji_mock_stats stats;
+} c_aji_mock = {
+    .pack_style = AJI_PACK_AUTO,
+};
+
+static const char *c_aji_mock_call_names[C_AJI_MOCK_CALL_COUNT] = {
+    [C_AJI_MOCK_CALL_GET_HARDWARE] = "get_hardware",
+    [C_AJI_MOCK_CALL_FIND_HARDWARE] = "find_hardware",
+    [C_AJI_MOCK_CALL_READ_DEVICE_CHAIN] = "read_device_chain",
+    [C_AJI_MOCK_CALL_GET_NODES] = "get_nodes",
+    [C_AJI_MOCK_CALL_OPEN] = "open",
+    [C_AJI_MOCK_CALL_CLOSE] = "close",
+    [C_AJI_MOCK_CALL_LOCK] = "lock",
+    [C_AJI_MOCK_CALL_UNLOCK] = "unlock",
+    [C_AJI_MOCK_CALL_LOCK_CHAIN] = "lock_chain",
+    [C_AJI_MOCK_CALL_UNLOCK_CHAIN] = "unlock_chain",
+    [C_AJI_MOCK_CALL_FLUSH] = "flush",
+    [C_AJI_MOCK_CALL_TEST_LOGIC_RESET] = "test_logic_reset",
+    [C_AJI_MOCK_CALL_DELAY] = "delay",
+    [C_AJI_MOCK_CALL_RUN_TEST_IDLE] = "run_test_idle",
+    [C_AJI_MOCK_CALL_ACCESS_IR] = "access_ir",
+    [C_AJI_MOCK_CALL_ACCESS_DR] = "access_dr",
+    [C_AJI_MOCK_CALL_ACCESS_OVERLAY] = "access_overlay",
+};
+
+//=====================================
+// Configuration and statistics
+//=====================================
+
+AJI_ERROR c_aji_mock_add_tap(DWORD idcode, DWORD irlen) {
+    if (c_aji_mock.tap_count == C_AJI_MOCK_MAX_TAPS) {
+        return AJI_TOO_MANY_DEVICES;
+    }
+    if (irlen < 2 || irlen > C_AJI_MOCK_MAX_IRLEN) {
+        return AJI_IR_LENGTH_ERROR;
+    }
+
+    struct c_aji_mock_tap *tap = &c_aji_mock.taps[c_aji_mock.tap_count++];
+    memset(tap, 0, sizeof(*tap));
+    tap->idcode = idcode;
+    tap->irlen = irlen;
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_mock_add_node(DWORD tap_position, DWORD idcode) {
+    if (tap_position >= c_aji_mock.tap_count) {
+        return AJI_BAD_TAP_POSITION;
+    }
+    struct c_aji_mock_tap *tap = &c_aji_mock.taps[tap_position];
+    if (tap->node_count == C_AJI_MOCK_MAX_NODES) {
+        return AJI_TOO_MANY_DEVICES;
+    }
+
+    struct c_aji_mock_node *node = &tap->nodes[tap->node_count++];
+    memset(node, 0, sizeof(*node));
+    node->idcode = idcode;
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_mock_add_dap(DWORD tap_position, DWORD memory_size) {
+    if (tap_position >= c_aji_mock.tap_count) {
+        return AJI_BAD_TAP_POSITION;
+    }
+    struct c_aji_mock_tap *tap = &c_aji_mock.taps[tap_position];
+    if (tap->irlen != C_AJI_MOCK_DAP_IRLEN) {
+        return AJI_IR_LENGTH_ERROR;
+    }
+    if (memory_size == 0 || tap->dap) {
+        return AJI_INVALID_PARAMETER;
+    }
+
+    struct c_aji_mock_dap *dap = calloc(1, sizeof(*dap));
+    if (!dap) {
+        return AJI_NO_MEMORY;
+    }
+    dap->memory = calloc(1, memory_size);
+    if (!dap->memory) {
+        free(dap);
+        return AJI_NO_MEMORY;
+    }
+    dap->memory_size = memory_size;
+    tap->dap = dap;
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_mock_get_ir(DWORD tap_position, QWORD *ir) {
+    if (tap_position >= c_aji_mock.tap_count) {
+        return AJI_BAD_TAP_POSITION;
+    }
+    *ir = c_aji_mock.taps[tap_position].ir;
+    return AJI_NO_ERROR;
+}
+
+enum c_aji_mock_state c_aji_mock_get_state(void) {
+    return c_aji_mock.state;
+}
+
+DWORD c_aji_mock_get_tap_count(void) {
+    return c_aji_mock.tap_count;
+}
+
+void c_aji_mock_set_latency(DWORD latency_us) {
+    c_aji_mock.latency_us = latency_us;
+}
+
+DWORD c_aji_mock_get_latency(void) {
+    return c_aji_mock.latency_us;
+}
+
+const struct c_aji_mock_stats* c_aji_mock_get_stats(void) {
+    return &c_aji_mock.stats;
+}
+
+void c_aji_mock_reset_stats(void) {
+    memset(&c_aji_mock.stats, 0, sizeof(c_aji_mock.stats));
+}
+
+const char* c_aji_mock_call_name(enum c_aji_mock_call call) {
+    if (call >= C_AJI_MOCK_CALL_COUNT) {
+        return "unknown";
+    }
+    return c_aji_mock_call_names[call];
+}
+
+/**
+ * Use the same chain as board/altera_arria10_niosv__aji_client.cfg
+ * if the user did not configure one.
+ */
+static void c_aji_mock_default_chain(void) {
+    if (c_aji_mock.tap_count) {
+        return;
+    }
+    c_aji_mock_add_tap(0x02ee20dd, 10);
+    c_aji_mock_add_node(0, 0x08986E00);
+    c_aji_mock_add_tap(0x4ba00477, 4);
+}
+
+//=====================================
+// Simulation
+//=====================================
+
+static bool c_aji_mock_get_bit(const BYTE *bits, DWORD index) {
+    return (bits[index / 8] >> (index % 8)) & 1;
+}
+
+static void c_aji_mock_set_bit(BYTE *bits, DWORD index, bool value) {
+    if (value) {
+        bits[index / 8] |= (BYTE)(1 << (index % 8));
+    } else {
+        bits[index / 8] &= (BYTE)~(1 << (index % 8));
+    }
+}
+
+/**
+ * Simulate one transaction with the JTAG server: inject the
+ * configured latency plus any c_aji_delay() requested since
+ * the last transaction.
+ */
+static void c_aji_mock_round_trip(void) {
+    DWORD delay_us = c_aji_mock.latency_us + c_aji_mock.pending_delay_us;
+    c_aji_mock.pending_delay_us = 0;
+
+    ++c_aji_mock.stats.round_trips;
+    c_aji_mock.stats.latency_us += delay_us;
+    if (delay_us) {
+        usleep(delay_us);
+    }
+}
+
+static bool c_aji_mock_deferred(void) {
+    return AJI_PACK_MANUAL == c_aji_mock.pack_style
+        || AJI_PACK_STREAM == c_aji_mock.pack_style;
+}
+
+/**
+ * The chain goes to RUN_TEST_IDLE, unless it stays in PAUSE_DR.
+ */
+static void c_aji_mock_end_in_idle(bool pause_dr) {
+    c_aji_mock.state = pause_dr ? C_AJI_MOCK_STATE_PAUSE_DR : C_AJI_MOCK_STATE_RUN_TEST_IDLE;
+    if (!pause_dr) {
+        ++c_aji_mock.stats.idle_visits;
+    }
+}
+
+static void c_aji_mock_copy_capture(const BYTE *data, DWORD bit_count, BYTE *read_bits, DWORD *read_dword) {
+    if (read_bits) {
+        for (DWORD i = 0; i < bit_count; ++i) {
+            c_aji_mock_set_bit(read_bits, i, c_aji_mock_get_bit(data, i));
+        }
+    }
+    if (read_dword) {
+        DWORD value = 0;
+        for (DWORD i = 0; i < bit_count && i < 32; ++i) {
+            value |= (DWORD)c_aji_mock_get_bit(data, i) << i;
+        }
+        *read_dword = value;
+    }
+}
+
+/**
+ * Hand captured data back to the caller, now if the open is not packing
+ * scans, otherwise when the scans are flushed.
+ */
+static AJI_ERROR c_aji_mock_deliver(const BYTE *data, DWORD bit_count, BYTE *read_bits, DWORD *read_dword) {
+    if (!c_aji_mock_deferred()) {
+        c_aji_mock_copy_capture(data, bit_count, read_bits, read_dword);
+        c_aji_mock_round_trip();
+        return AJI_NO_ERROR;
+    }
+    if (!read_bits && !read_dword) {
+        return AJI_NO_ERROR;
+    }
+
+    if (c_aji_mock.pending_count == c_aji_mock.pending_size) {
+        DWORD size = c_aji_mock.pending_size ? 2 * c_aji_mock.pending_size : 64;
+        struct c_aji_mock_capture **pending =
+            realloc(c_aji_mock.pending, size * sizeof(*pending));
+        if (!pending) {
+            return AJI_NO_MEMORY;
+        }
+        c_aji_mock.pending = pending;
+        c_aji_mock.pending_size = size;
+    }
+
+    DWORD bytes = (bit_count + 7) / 8;
+    struct c_aji_mock_capture *capture = malloc(sizeof(*capture) + bytes);
+    if (!capture) {
+        return AJI_NO_MEMORY;
+    }
+    capture->read_bits = read_bits;
+    capture->read_dword = read_dword;
+    capture->bit_count = bit_count;
+    memcpy(capture->data, data, bytes);
+    c_aji_mock.pending[c_aji_mock.pending_count++] = capture;
+    return AJI_NO_ERROR;
+}
+
+static void c_aji_mock_deliver_pending(void) {
+    for (DWORD i = 0; i < c_aji_mock.pending_count; ++i) {
+        struct c_aji_mock_capture *capture = c_aji_mock.pending[i];
+        c_aji_mock_copy_capture(capture->data, capture->bit_count,
+            capture->read_bits, capture->read_dword);
+        free(capture);
+    }
+    c_aji_mock.pending_count = 0;
+}
+
+static AJI_ERROR c_aji_mock_grow_register(struct c_aji_mock_register *reg, DWORD bit_count) {
+    DWORD bytes = (bit_count + 7) / 8;
+    if (bytes <= reg->size) {
+        return AJI_NO_ERROR;
+    }
+    BYTE *bits = realloc(reg->bits, bytes);
+    if (!bits) {
+        return AJI_NO_MEMORY;
+    }
+    memset(bits + reg->size, 0, bytes - reg->size);
+    reg->bits = bits;
+    reg->size = bytes;
+    return AJI_NO_ERROR;
+}
+
+static bool c_aji_mock_dap_selected(const struct c_aji_mock_tap *tap) {
+    return tap->dap
+        && (C_AJI_MOCK_DAP_IR_ABORT == tap->ir
+            || C_AJI_MOCK_DAP_IR_DPACC == tap->ir
+            || C_AJI_MOCK_DAP_IR_APACC == tap->ir);
+}
+
+/**
+ * Move size bytes between the MEM-AP memory at address and the byte
+ * lanes of data the address selects.
+ */
+static void c_aji_mock_dap_memory(struct c_aji_mock_dap *dap, DWORD address, DWORD size, DWORD *data, bool read) {
+    for (DWORD b = 0; b < size; ++b) {
+        DWORD lane = ((address + b) & 3) * 8;
+        BYTE *byte = &dap->memory[(address + b) % dap->memory_size];
+        if (read) {
+            *data = (*data & ~((DWORD)0xFF << lane)) | (DWORD)*byte << lane;
+        } else {
+            *byte = (BYTE)(*data >> lane);
+        }
+    }
+}
+
+/**
+ * DRW access at TAR: one transfer of the CSW size, or as many as fit
+ * in 32 bits if packed, then auto-increment TAR.
+ */
+static void c_aji_mock_dap_drw(struct c_aji_mock_dap *dap, DWORD *data, bool read) {
+    DWORD size = 1 << (dap->csw & C_AJI_MOCK_CSW_SIZE);
+    if (size > 4) {
+        size = 4;
+    }
+    DWORD transfers = 1;
+    DWORD increment = 0;
+    switch (dap->csw & C_AJI_MOCK_CSW_ADDRINC) {
+    case C_AJI_MOCK_CSW_SINGLE:
+        increment = size;
+        break;
+    case C_AJI_MOCK_CSW_PACKED:
+        transfers = 4 / size;
+        increment = 4;
+        break;
+    }
+
+    for (DWORD t = 0; t < transfers; ++t) {
+        c_aji_mock_dap_memory(dap, dap->tar + t * size, size, data, read);
+    }
+    dap->tar = (dap->tar & ~C_AJI_MOCK_TAR_WRAP) | ((dap->tar + increment) & C_AJI_MOCK_TAR_WRAP);
+    ++c_aji_mock.stats.dap_memory_accesses;
+}
+
+static void c_aji_mock_dap_ap_access(struct c_aji_mock_dap *dap, DWORD address, DWORD *data, bool read) {
+    if (dap->select >> 24) {
+        *data = 0; // There is no AP but APSEL 0
+        return;
+    }
+
+    DWORD reg = (dap->select & 0xF0) | address;
+    if (reg >= C_AJI_MOCK_AP_BD0 && reg <= C_AJI_MOCK_AP_BD3) {
+        c_aji_mock_dap_memory(dap, (dap->tar & ~(DWORD)0xF) | (reg & 0xC), 4, data, read);
+        ++c_aji_mock.stats.dap_memory_accesses;
+        return;
+    }
+
+    switch (reg) {
+    case C_AJI_MOCK_AP_CSW:
+        if (read) {
+            *data = dap->csw | C_AJI_MOCK_CSW_DEVICE_EN;
+        } else {
+            dap->csw = *data & ~(C_AJI_MOCK_CSW_DEVICE_EN | C_AJI_MOCK_CSW_TR_IN_PROG);
+            ++c_aji_mock.stats.dap_csw_writes;
+        }
+        break;
+    case C_AJI_MOCK_AP_TAR:
+        if (read) {
+            *data = dap->tar;
+        } else {
+            dap->tar = *data;
+            ++c_aji_mock.stats.dap_tar_writes;
+        }
+        break;
+    case C_AJI_MOCK_AP_DRW:
+        c_aji_mock_dap_drw(dap, data, read);
+        break;
+    case C_AJI_MOCK_AP_BASE:
+        *data = C_AJI_MOCK_AP_BASE_NONE;
+        break;
+    case C_AJI_MOCK_AP_IDR:
+        *data = C_AJI_MOCK_AP_IDR_AHB_AP;
+        break;
+    default:
+        *data = 0; // CFG is 0 too: little endian, 32-bit addresses and data
+        break;
+    }
+}
+
+static void c_aji_mock_dap_dp_access(struct c_aji_mock_dap *dap, DWORD address, DWORD *data, bool read) {
+    switch (address) {
+    case C_AJI_MOCK_DP_CTRL_STAT:
+        if (read) {
+            // Every power-up request is acked right away
+            *data = dap->ctrl_stat | (dap->ctrl_stat & C_AJI_MOCK_DP_PWRUP_REQ) << 1;
+        } else {
+            dap->ctrl_stat = *data & C_AJI_MOCK_DP_CTRL_RW;
+        }
+        break;
+    case C_AJI_MOCK_DP_SELECT:
+        if (read) {
+            *data = dap->select;
+        } else {
+            dap->select = *data;
+        }
+        break;
+    case C_AJI_MOCK_DP_RDBUFF:
+        *data = dap->read_result; // Read again, without side effect
+        break;
+    default:
+        *data = 0;
+        break;
+    }
+}
+
+/**
+ * Scan the 35-bit JTAG-DP register: capture OK and the previous read
+ * result, then carry out the transaction shifted in.
+ */
+static QWORD c_aji_mock_dap_scan(struct c_aji_mock_tap *tap, QWORD in) {
+    struct c_aji_mock_dap *dap = tap->dap;
+    QWORD capture = (QWORD)dap->read_result << 3 | C_AJI_MOCK_DAP_ACK_OK;
+    if (C_AJI_MOCK_DAP_IR_ABORT == tap->ir) {
+        return capture;
+    }
+
+    bool read = in & 1;
+    DWORD address = (DWORD)(in >> 1 & 3) << 2;
+    DWORD data = read ? 0 : (DWORD)(in >> 3);
+    if (C_AJI_MOCK_DAP_IR_DPACC == tap->ir) {
+        c_aji_mock_dap_dp_access(dap, address, &data, read);
+    } else {
+        c_aji_mock_dap_ap_access(dap, address, &data, read);
+    }
+    if (read) {
+        dap->read_result = data;
+    }
+    ++c_aji_mock.stats.dap_transactions;
+    return capture;
+}
+
+static struct c_aji_mock_open* c_aji_mock_find_open(AJI_OPEN_ID open_id) {
+    for (struct c_aji_mock_open *open = c_aji_mock.opens; open; open = open->next) {
+        if ((AJI_OPEN_ID)open == open_id) {
+            return open;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Check that open_id is locked, which the JTAG server requires
+ * before any scan.
+ */
+static AJI_ERROR c_aji_mock_locked_open(AJI_OPEN_ID open_id, struct c_aji_mock_open **open) {
+    *open = c_aji_mock_find_open(open_id);
+    if (!*open) {
+        return AJI_INVALID_OPEN_ID;
+    }
+    if (c_aji_mock.locked != *open) {
+        return AJI_NOT_LOCKED;
+    }
+    return AJI_NO_ERROR;
+}
+
+static AJI_ERROR c_aji_mock_check_chain(AJI_CHAIN_ID chain_id) {
+    if (chain_id != &c_aji_mock.chain) {
+        return AJI_INVALID_CHAIN_ID;
+    }
+    return AJI_NO_ERROR;
+}
+
+static AJI_ERROR c_aji_mock_open(DWORD tap_position, DWORD node_position, AJI_OPEN_ID *open_id) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_OPEN];
+    c_aji_mock_round_trip();
+
+    if (tap_position >= c_aji_mock.tap_count) {
+        return AJI_BAD_TAP_POSITION;
+    }
+    if (node_position != C_AJI_MOCK_NO_NODE
+        && node_position >= c_aji_mock.taps[tap_position].node_count) {
+        return AJI_NO_MATCHING_NODES;
+    }
+
+    struct c_aji_mock_open *open = calloc(1, sizeof(*open));
+    if (!open) {
+        return AJI_NO_MEMORY;
+    }
+    open->tap_position = tap_position;
+    open->node_position = node_position;
+    open->next = c_aji_mock.opens;
+    c_aji_mock.opens = open;
+    *open_id = (AJI_OPEN_ID)open;
+    return AJI_NO_ERROR;
+}
+
+static DWORD c_aji_mock_find_node(DWORD tap_position, DWORD node_position, DWORD idcode) {
+    if (tap_position >= c_aji_mock.tap_count) {
+        return C_AJI_MOCK_NO_NODE;
+    }
+    struct c_aji_mock_tap *tap = &c_aji_mock.taps[tap_position];
+    if (node_position < tap->node_count) {
+        return tap->nodes[node_position].idcode == idcode ? node_position : C_AJI_MOCK_NO_NODE;
+    }
+    for (DWORD n = 0; n < tap->node_count; ++n) {
+        if (tap->nodes[n].idcode == idcode) {
+            return n;
+        }
+    }
+    return C_AJI_MOCK_NO_NODE;
+}
+
+//=====================================
+// Library lifecycle
+//=====================================
+
+AJI_ERROR c_jtag_client_gnuaji_init(void) {
+    LOG_INFO("aji_client is using the simulated JTAG server (%lu TAPs, latency %luus)",
+        (unsigned long)c_aji_mock.tap_count, (unsigned long)c_aji_mock.latency_us
+    );
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_jtag_client_gnuaji_free(void) {
+    c_aji_mock_deliver_pending();
+    free(c_aji_mock.pending);
+    c_aji_mock.pending = NULL;
+    c_aji_mock.pending_size = 0;
+
+    while (c_aji_mock.opens) {
+        struct c_aji_mock_open *next = c_aji_mock.opens->next;
+        free(c_aji_mock.opens);
+        c_aji_mock.opens = next;
+    }
+    c_aji_mock.locked = NULL;
+    c_aji_mock.chain.locked = false;
+    c_aji_mock.pack_style = AJI_PACK_AUTO;
+
+    for (DWORD t = 0; t < c_aji_mock.tap_count; ++t) {
+        struct c_aji_mock_tap *tap = &c_aji_mock.taps[t];
+        free(tap->dr.bits);
+        memset(&tap->dr, 0, sizeof(tap->dr));
+        if (tap->dap) {
+            free(tap->dap->memory);
+            free(tap->dap);
+            tap->dap = NULL;
+        }
+        for (DWORD n = 0; n < tap->node_count; ++n) {
+            free(tap->nodes[n].dr.bits);
+            memset(&tap->nodes[n].dr, 0, sizeof(tap->nodes[n].dr));
+        }
+    }
+    return AJI_NO_ERROR;
+}
+
+//=====================================
+// Hardware and chain discovery
+//=====================================
+
+static void c_aji_mock_fill_hardware(AJI_HARDWARE *hardware) {
+    hardware->chain_id = &c_aji_mock.chain;
+    hardware->persistent_id = C_AJI_MOCK_PERSISTENT_ID;
+    hardware->hw_name = C_AJI_MOCK_HARDWARE_NAME;
+    hardware->port = C_AJI_MOCK_HARDWARE_PORT;
+    hardware->device_name = NULL;
+    hardware->chain_type = AJI_CHAIN_JTAG;
+    hardware->server = NULL;
+    hardware->features = AJI_FEATURE_JTAG;
+}
+
+AJI_ERROR c_aji_get_hardware(DWORD *hardware_count, AJI_HARDWARE *hardware_list, DWORD timeout) {
+    return c_aji_get_hardware2(hardware_count, hardware_list, NULL, timeout);
+}
+
+AJI_ERROR c_aji_get_hardware2(DWORD *hardware_count, AJI_HARDWARE *hardware_list, char **server_version_info_list, DWORD timeout) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_GET_HARDWARE];
+    c_aji_mock_round_trip();
+    c_aji_mock_default_chain();
+
+    if (*hardware_count < 1 || !hardware_list) {
+        *hardware_count = 1;
+        return AJI_TOO_MANY_DEVICES;
+    }
+    *hardware_count = 1;
+    c_aji_mock_fill_hardware(&hardware_list[0]);
+    if (server_version_info_list) {
+        server_version_info_list[0] = (char *)"AJI mock";
+    }
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_find_hardware(DWORD persistent_id, AJI_HARDWARE *hardware, DWORD timeout) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_FIND_HARDWARE];
+    c_aji_mock_round_trip();
+    c_aji_mock_default_chain();
+
+    if (persistent_id != C_AJI_MOCK_PERSISTENT_ID) {
+        return AJI_UNKNOWN_HARDWARE;
+    }
+    c_aji_mock_fill_hardware(hardware);
+    return AJI_NO_ERROR;
+}
+
+/**
+ * The simulated cable stands in for whichever cable the
+ * configuration asks for, so existing board files can be used as-is.
+ */
+AJI_ERROR c_aji_find_hardware_a(const char *hw_name, AJI_HARDWARE *hardware, DWORD timeout) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_FIND_HARDWARE];
+    c_aji_mock_round_trip();
+    c_aji_mock_default_chain();
+
+    LOG_DEBUG("Simulating hardware '%s'", hw_name);
+    c_aji_mock_fill_hardware(hardware);
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_read_device_chain(AJI_CHAIN_ID chain_id, DWORD *device_count, AJI_DEVICE *device_list, _Bool auto_scan) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_READ_DEVICE_CHAIN];
+    c_aji_mock_round_trip();
+
+    AJI_ERROR status = c_aji_mock_check_chain(chain_id);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    if (*device_count < c_aji_mock.tap_count || !device_list) {
+        *device_count = c_aji_mock.tap_count;
+        return AJI_TOO_MANY_DEVICES;
+    }
+
+    *device_count = c_aji_mock.tap_count;
+    for (DWORD t = 0; t < c_aji_mock.tap_count; ++t) {
+        struct c_aji_mock_tap *tap = &c_aji_mock.taps[t];
+        device_list[t].device_id = tap->idcode;
+        device_list[t].mask = 0;
+        device_list[t].instruction_length = (BYTE)tap->irlen;
+        device_list[t].features = tap->node_count ? AJI_DEVFEAT_POSSIBLE_HUB : 0;
+        device_list[t].device_name = NULL;
+    }
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_get_nodes(AJI_CHAIN_ID chain_id, DWORD tap_position, DWORD *idcodes, DWORD *idcode_n) {
+    return c_aji_get_nodes_a(chain_id, tap_position, idcodes, idcode_n, NULL);
+}
+
+AJI_ERROR c_aji_get_nodes_a(AJI_CHAIN_ID chain_id, DWORD tap_position, DWORD *idcodes, DWORD *idcode_n, DWORD *hub_info) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_GET_NODES];
+    c_aji_mock_round_trip();
+
+    AJI_ERROR status = c_aji_mock_check_chain(chain_id);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    if (tap_position >= c_aji_mock.tap_count) {
+        return AJI_BAD_TAP_POSITION;
+    }
+
+    struct c_aji_mock_tap *tap = &c_aji_mock.taps[tap_position];
+    if (*idcode_n < tap->node_count) {
+        *idcode_n = tap->node_count;
+        return AJI_TOO_MANY_DEVICES;
+    }
+    *idcode_n = tap->node_count;
+    for (DWORD n = 0; n < tap->node_count; ++n) {
+        idcodes[n] = tap->nodes[n].idcode;
+    }
+    if (hub_info) {
+        *hub_info = tap->node_count ? C_AJI_MOCK_HUB_IDCODE : 0;
+    }
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_get_nodes_b(AJI_CHAIN_ID chain_id, DWORD tap_position, AJI_HIER_ID *hier_ids, DWORD *hier_id_n, AJI_HUB_INFO *hub_infos) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_GET_NODES];
+    c_aji_mock_round_trip();
+
+    AJI_ERROR status = c_aji_mock_check_chain(chain_id);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    if (tap_position >= c_aji_mock.tap_count) {
+        return AJI_BAD_TAP_POSITION;
+    }
+
+    struct c_aji_mock_tap *tap = &c_aji_mock.taps[tap_position];
+    if (*hier_id_n < tap->node_count) {
+        *hier_id_n = tap->node_count;
+        return AJI_TOO_MANY_DEVICES;
+    }
+    *hier_id_n = tap->node_count;
+    for (DWORD n = 0; n < tap->node_count; ++n) {
+        memset(&hier_ids[n], 0, sizeof(hier_ids[n]));
+        hier_ids[n].idcode = tap->nodes[n].idcode;
+        hier_ids[n].position_n = 0;
+        hier_ids[n].positions[0] = (BYTE)n;
+
+        if (hub_infos) {
+            memset(&hub_infos[n], 0, sizeof(hub_infos[n]));
+            hub_infos[n].hub_idcode[0] = C_AJI_MOCK_HUB_IDCODE;
+        }
+    }
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_get_nodes_bi(AJI_CHAIN_ID chain_id, DWORD tap_position, AJI_HIER_ID *hier_ids, DWORD *hier_id_n, AJI_HUB_INFO *hub_infos) {
+    return c_aji_get_nodes_b(chain_id, tap_position, hier_ids, hier_id_n, hub_infos);
+}
+
+//=====================================
+// Open/close
+//=====================================
+
+AJI_ERROR c_aji_open_device(AJI_CHAIN_ID chain_id, DWORD tap_position, AJI_OPEN_ID *open_id, const AJI_CLAIM *claims, DWORD claim_n, const char *application_name) {
+    AJI_ERROR status = c_aji_mock_check_chain(chain_id);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    return c_aji_mock_open(tap_position, C_AJI_MOCK_NO_NODE, open_id);
+}
+
+AJI_ERROR c_aji_open_device_a(AJI_CHAIN_ID chain_id, DWORD tap_position, AJI_OPEN_ID *open_id, const AJI_CLAIM2 *claims, DWORD claim_n, const char *application_name) {
+    AJI_ERROR status = c_aji_mock_check_chain(chain_id);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    return c_aji_mock_open(tap_position, C_AJI_MOCK_NO_NODE, open_id);
+}
+
+AJI_ERROR c_aji_close_device(AJI_OPEN_ID open_id) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_CLOSE];
+    c_aji_mock_round_trip();
+
+    struct c_aji_mock_open **link = &c_aji_mock.opens;
+    while (*link && (AJI_OPEN_ID)*link != open_id) {
+        link = &(*link)->next;
+    }
+    if (!*link) {
+        return AJI_INVALID_OPEN_ID;
+    }
+
+    struct c_aji_mock_open *open = *link;
+    if (c_aji_mock.locked == open) {
+        c_aji_mock_deliver_pending();
+        c_aji_mock.locked = NULL;
+    }
+    *link = open->next;
+    free(open);
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_open_entire_device_chain(AJI_CHAIN_ID chain_id, AJI_OPEN_ID *open_id, AJI_CHAIN_TYPE style, const char *application_name) {
+    return AJI_UNIMPLEMENTED;
+}
+
+AJI_ERROR c_aji_open_node(AJI_CHAIN_ID chain_id, DWORD tap_position, DWORD idcode, AJI_OPEN_ID *node_id, const AJI_CLAIM *claims, DWORD claim_n, const char *application_name) {
+    return c_aji_open_node_a(chain_id, tap_position, C_AJI_MOCK_NO_NODE, idcode, node_id, claims, claim_n, application_name);
+}
+
+AJI_ERROR c_aji_open_node_a(AJI_CHAIN_ID chain_id, DWORD tap_position, DWORD node_position, DWORD idcode, AJI_OPEN_ID *node_id, const AJI_CLAIM *claims, DWORD claim_n, const char *application_name) {
+    AJI_ERROR status = c_aji_mock_check_chain(chain_id);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    DWORD node = c_aji_mock_find_node(tap_position, node_position, idcode);
+    if (C_AJI_MOCK_NO_NODE == node) {
+        return AJI_NO_MATCHING_NODES;
+    }
+    return c_aji_mock_open(tap_position, node, node_id);
+}
+
+AJI_ERROR c_aji_open_node_b(AJI_CHAIN_ID chain_id, DWORD tap_position, const AJI_HIER_ID *hier_id, AJI_OPEN_ID *node_id, const AJI_CLAIM2 *claims, DWORD claim_n, const char *application_name) {
+    AJI_ERROR status = c_aji_mock_check_chain(chain_id);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    if (hier_id->position_n != 0) {
+        return AJI_HIERARCHICAL_HUB_NOT_SUPPORTED;
+    }
+    DWORD node = c_aji_mock_find_node(tap_position, hier_id->positions[0], hier_id->idcode);
+    if (C_AJI_MOCK_NO_NODE == node) {
+        return AJI_NO_MATCHING_NODES;
+    }
+    return c_aji_mock_open(tap_position, node, node_id);
+}
+
+//=====================================
+// Lock/unlock
+//=====================================
+
+AJI_ERROR c_aji_lock(AJI_OPEN_ID open_id, DWORD timeout, AJI_PACK_STYLE pack_style) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_LOCK];
+    c_aji_mock_round_trip();
+
+    struct c_aji_mock_open *open = c_aji_mock_find_open(open_id);
+    if (!open) {
+        return AJI_INVALID_OPEN_ID;
+    }
+    if (c_aji_mock.locked == open) {
+        return AJI_NO_ERROR;
+    }
+    if (c_aji_mock.locked) {
+        return AJI_LOCKED;
+    }
+    c_aji_mock.locked = open;
+    c_aji_mock.pack_style = pack_style;
+    return AJI_NO_ERROR;
+}
+
+/**
+ * Unlock also flushes, so packed scans and the unlock
+ * travel together in one transaction.
+ */
+AJI_ERROR c_aji_unlock(AJI_OPEN_ID open_id) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_UNLOCK];
+
+    struct c_aji_mock_open *open = NULL;
+    AJI_ERROR status = c_aji_mock_locked_open(open_id, &open);
+    if (AJI_NO_ERROR != status) {
+        c_aji_mock_round_trip();
+        return status;
+    }
+    c_aji_mock_deliver_pending();
+    c_aji_mock_round_trip();
+    c_aji_mock.locked = NULL;
+    c_aji_mock.pack_style = AJI_PACK_AUTO;
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_lock_chain(AJI_CHAIN_ID chain_id, DWORD timeout) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_LOCK_CHAIN];
+    c_aji_mock_round_trip();
+
+    AJI_ERROR status = c_aji_mock_check_chain(chain_id);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    if (chain_id->locked) {
+        return AJI_LOCKED;
+    }
+    chain_id->locked = true;
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_unlock_chain(AJI_CHAIN_ID chain_id) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_UNLOCK_CHAIN];
+    c_aji_mock_round_trip();
+
+    AJI_ERROR status = c_aji_mock_check_chain(chain_id);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    if (!chain_id->locked) {
+        return AJI_NOT_LOCKED;
+    }
+    chain_id->locked = false;
+    return AJI_NO_ERROR;
+}
+
+AJI_ERROR c_aji_unlock_lock_chain(AJI_OPEN_ID unlock_id, AJI_CHAIN_ID lock_id) {
+    AJI_ERROR status = c_aji_unlock(unlock_id);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    return c_aji_lock_chain(lock_id, 0);
+}
+
+AJI_ERROR c_aji_unlock_chain_lock(AJI_CHAIN_ID unlock_id, AJI_OPEN_ID lock_id, AJI_PACK_STYLE pack_style) {
+    AJI_ERROR status = c_aji_unlock_chain(unlock_id);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    return c_aji_lock(lock_id, 0, pack_style);
+}
+
+AJI_ERROR c_aji_flush(AJI_OPEN_ID open_id) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_FLUSH];
+
+    struct c_aji_mock_open *open = NULL;
+    AJI_ERROR status = c_aji_mock_locked_open(open_id, &open);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    c_aji_mock_deliver_pending();
+    c_aji_mock_round_trip();
+    return AJI_NO_ERROR;
+}
+
+//=====================================
+// Scans
+//=====================================
+
+AJI_ERROR c_aji_test_logic_reset(AJI_OPEN_ID open_id) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_TEST_LOGIC_RESET];
+
+    struct c_aji_mock_open *open = NULL;
+    AJI_ERROR status = c_aji_mock_locked_open(open_id, &open);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+
+    // Every TAP selects IDCODE, so the next DR scan reads the IDCODEs back
+    for (DWORD t = 0; t < c_aji_mock.tap_count; ++t) {
+        struct c_aji_mock_tap *tap = &c_aji_mock.taps[t];
+        tap->ir = ~(QWORD)0 >> (64 - tap->irlen);
+        status = c_aji_mock_grow_register(&tap->dr, 32);
+        if (AJI_NO_ERROR != status) {
+            return status;
+        }
+        memset(tap->dr.bits, 0, tap->dr.size);
+        for (DWORD i = 0; i < 32; ++i) {
+            c_aji_mock_set_bit(tap->dr.bits, i, (tap->idcode >> i) & 1);
+        }
+    }
+    c_aji_mock.state = C_AJI_MOCK_STATE_TEST_LOGIC_RESET;
+    return c_aji_mock_deliver(NULL, 0, NULL, NULL);
+}
+
+AJI_ERROR c_aji_delay(AJI_OPEN_ID open_id, DWORD timeout_microseconds) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_DELAY];
+
+    struct c_aji_mock_open *open = NULL;
+    AJI_ERROR status = c_aji_mock_locked_open(open_id, &open);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    c_aji_mock.pending_delay_us += timeout_microseconds;
+    return c_aji_mock_deliver(NULL, 0, NULL, NULL);
+}
+
+AJI_ERROR c_aji_run_test_idle(AJI_OPEN_ID open_id, DWORD num_clocks) {
+    return c_aji_run_test_idle_a(open_id, num_clocks, 0);
+}
+
+AJI_ERROR c_aji_run_test_idle_a(AJI_OPEN_ID open_id, DWORD num_clocks, DWORD flags) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_RUN_TEST_IDLE];
+
+    struct c_aji_mock_open *open = NULL;
+    AJI_ERROR status = c_aji_mock_locked_open(open_id, &open);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    c_aji_mock_end_in_idle(false);
+    return c_aji_mock_deliver(NULL, 0, NULL, NULL);
+}
+
+static AJI_ERROR c_aji_mock_access_ir(AJI_OPEN_ID open_id, DWORD length_ir, const BYTE *write_bits, QWORD instruction, BYTE *read_bits, DWORD *read_dword) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_ACCESS_IR];
+
+    struct c_aji_mock_open *open = NULL;
+    AJI_ERROR status = c_aji_mock_locked_open(open_id, &open);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    if (open->node_position != C_AJI_MOCK_NO_NODE) {
+        return AJI_INVALID_PARAMETER; //SLD nodes are selected with c_aji_access_overlay()
+    }
+
+    struct c_aji_mock_tap *tap = &c_aji_mock.taps[open->tap_position];
+    if (length_ir != tap->irlen) {
+        return AJI_IR_LENGTH_ERROR;
+    }
+    if (write_bits) {
+        instruction = 0;
+        for (DWORD i = 0; i < length_ir; ++i) {
+            instruction |= (QWORD)c_aji_mock_get_bit(write_bits, i) << i;
+        }
+    }
+    tap->ir = instruction;
+    c_aji_mock.stats.bits_scanned += length_ir;
+    c_aji_mock_end_in_idle(false);
+
+    // IEEE 1149.1 requires the IR to capture 'b01
+    BYTE capture[C_AJI_MOCK_MAX_IRLEN / 8] = { 0x01 };
+    return c_aji_mock_deliver(capture, length_ir, read_bits, read_dword);
+}
+
+AJI_ERROR c_aji_access_ir(AJI_OPEN_ID open_id, DWORD instruction, DWORD *captured_ir, DWORD flags) {
+    struct c_aji_mock_open *open = c_aji_mock_find_open(open_id);
+    if (!open) {
+        return AJI_INVALID_OPEN_ID;
+    }
+    DWORD length_ir = c_aji_mock.taps[open->tap_position].irlen;
+    if (length_ir > 32) {
+        return AJI_IR_LENGTH_ERROR;
+    }
+    return c_aji_mock_access_ir(open_id, length_ir, NULL, instruction, NULL, captured_ir);
+}
+
+AJI_ERROR c_aji_access_ir_a(AJI_OPEN_ID open_id, DWORD length_ir, const BYTE *write_bits, BYTE *read_bits, DWORD flags) {
+    return c_aji_mock_access_ir(open_id, length_ir, write_bits, 0, read_bits, NULL);
+}
+
+AJI_ERROR c_aji_access_dr(AJI_OPEN_ID open_id, DWORD length_dr, DWORD flags, DWORD write_offset, DWORD write_length, const BYTE *write_bits, DWORD read_offset, DWORD read_length, BYTE *read_bits) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_ACCESS_DR];
+
+    struct c_aji_mock_open *open = NULL;
+    AJI_ERROR status = c_aji_mock_locked_open(open_id, &open);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    if (length_dr == 0
+        || write_offset + write_length > length_dr
+        || read_offset + read_length > length_dr
+        || (write_length && !write_bits)
+        || (read_length && !read_bits)) {
+        return AJI_INVALID_PARAMETER;
+    }
+
+    struct c_aji_mock_tap *tap = &c_aji_mock.taps[open->tap_position];
+    struct c_aji_mock_register *reg = open->node_position == C_AJI_MOCK_NO_NODE
+        ? &tap->dr
+        : &tap->nodes[open->node_position].dr;
+    status = c_aji_mock_grow_register(reg, length_dr);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+
+    // Capture what the previous scan left behind, then shift in the new bits.
+    // Bits the caller does not specify are written as 0.
+    BYTE *capture = calloc(1, (read_length + 7) / 8 + 1);
+    if (!capture) {
+        return AJI_NO_MEMORY;
+    }
+    if (open->node_position == C_AJI_MOCK_NO_NODE && c_aji_mock_dap_selected(tap)) {
+        QWORD in = 0;
+        for (DWORD i = write_offset; i < write_offset + write_length && i < C_AJI_MOCK_DAP_DR_LENGTH; ++i) {
+            in |= (QWORD)c_aji_mock_get_bit(write_bits, i - write_offset) << i;
+        }
+        QWORD out = c_aji_mock_dap_scan(tap, in);
+        for (DWORD i = 0; i < read_length && read_offset + i < C_AJI_MOCK_DAP_DR_LENGTH; ++i) {
+            c_aji_mock_set_bit(capture, i, (out >> (read_offset + i)) & 1);
+        }
+    } else {
+        for (DWORD i = 0; i < read_length; ++i) {
+            c_aji_mock_set_bit(capture, i, c_aji_mock_get_bit(reg->bits, read_offset + i));
+        }
+        for (DWORD i = 0; i < length_dr; ++i) {
+            bool bit = false;
+            if (i >= write_offset && i < write_offset + write_length) {
+                bit = c_aji_mock_get_bit(write_bits, i - write_offset);
+            }
+            c_aji_mock_set_bit(reg->bits, i, bit);
+        }
+    }
+    c_aji_mock.stats.bits_scanned += length_dr;
+
+    // Without AJI_DR_START_PAUSE_DR, the scan leaves PAUSE_DR through RUN_TEST_IDLE
+    if (C_AJI_MOCK_STATE_PAUSE_DR == c_aji_mock.state && !(flags & AJI_DR_START_PAUSE_DR)) {
+        ++c_aji_mock.stats.idle_visits;
+    }
+    c_aji_mock_end_in_idle(flags & AJI_DR_END_PAUSE_DR);
+
+    status = c_aji_mock_deliver(capture, read_length, read_length ? read_bits : NULL, NULL);
+    free(capture);
+    return status;
+}
+
+AJI_ERROR c_aji_access_dr_a(AJI_OPEN_ID open_id, DWORD length_dr, DWORD flags, DWORD write_offset, DWORD write_length, const BYTE *write_bits, DWORD read_offset, DWORD read_length, BYTE *read_bits, DWORD batch) {
+    return c_aji_access_dr(open_id, length_dr, flags, write_offset, write_length, write_bits, read_offset, read_length, read_bits);
+}
+
+AJI_ERROR c_aji_access_overlay(AJI_OPEN_ID node_id, DWORD overlay, DWORD *captured_overlay) {
+    ++c_aji_mock.stats.calls[C_AJI_MOCK_CALL_ACCESS_OVERLAY];
+
+    struct c_aji_mock_open *open = NULL;
+    AJI_ERROR status = c_aji_mock_locked_open(node_id, &open);
+    if (AJI_NO_ERROR != status) {
+        return status;
+    }
+    if (open->node_position == C_AJI_MOCK_NO_NODE) {
+        return AJI_INVALID_PARAMETER;
+    }
+
+    struct c_aji_mock_node *node = &c_aji_mock.taps[open->tap_position].nodes[open->node_position];
+    BYTE capture[4];
+    for (DWORD i = 0; i < 4; ++i) {
+        capture[i] = (BYTE)(node->overlay >> (8 * i));
+    }
+    node->overlay = overlay;
+    c_aji_mock.stats.bits_scanned += 32;
+    c_aji_mock_end_in_idle(false);
+    return c_aji_mock_deliver(capture, 32, NULL, captured_overlay);
+}
+
+#endif //BUILD_AJI_CLIENT_MOCK
@@ -0,0 +1,163 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Intel Corporation                               *
+ *   SPDX-License-Identifier: GPL-2.0-or-later                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef INC_C_JTAG_CLIENT_GNUAJI_MOCK_H
+#define INC_C_JTAG_CLIENT_GNUAJI_MOCK_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#if BUILD_AJI_CLIENT_MOCK
+
+#include "c_aji.h"
+
+/**
+ * In-process simulated JTAG server.
+ *
+ * Replaces libaji_client when configured with --enable-aji_client-mock.
+ * It models one cable with a chain of TAPs, each of which can have
+ * an SLD hub with a number of nodes. Every DR, including the SLD node's,
+ * is a loopback register: a scan captures the bits shifted in by the
+ * previous scan. After a test logic reset the DR holds the TAP IDCODE.
+ * The chain starts in TEST_LOGIC_RESET, which c_aji_test_logic_reset()
+ * goes back to. Every other operation ends in RUN_TEST_IDLE, except a DR
+ * scan with AJI_DR_END_PAUSE_DR, which stays in PAUSE_DR. The next DR
+ * scan only starts from PAUSE_DR with AJI_DR_START_PAUSE_DR.
+ *
+ * A TAP can instead model an ARM JTAG-DP with one MEM-AP in front of
+ * some RAM, @see c_aji_mock_add_dap().
+ *
+ * Every call that would have been a round trip to jtagd/jtagserv
+ * sleeps for the configured latency. With AJI_PACK_MANUAL or
+ * AJI_PACK_STREAM, scans are only delivered, and the latency charged,
+ * by c_aji_flush() or c_aji_unlock().
+ */
+
+#define C_AJI_MOCK_MAX_TAPS   32
+#define C_AJI_MOCK_MAX_NODES  32 //< per TAP
+#define C_AJI_MOCK_MAX_IRLEN  64
+
+#define C_AJI_MOCK_HARDWARE_NAME "AJI-Mock"
+#define C_AJI_MOCK_HARDWARE_PORT "mock"
+
+enum c_aji_mock_call {
+    C_AJI_MOCK_CALL_GET_HARDWARE = 0,
+    C_AJI_MOCK_CALL_FIND_HARDWARE,
+    C_AJI_MOCK_CALL_READ_DEVICE_CHAIN,
+    C_AJI_MOCK_CALL_GET_NODES,
+    C_AJI_MOCK_CALL_OPEN,
+    C_AJI_MOCK_CALL_CLOSE,
+    C_AJI_MOCK_CALL_LOCK,
+    C_AJI_MOCK_CALL_UNLOCK,
+    C_AJI_MOCK_CALL_LOCK_CHAIN,
+    C_AJI_MOCK_CALL_UNLOCK_CHAIN,
+    C_AJI_MOCK_CALL_FLUSH,
+    C_AJI_MOCK_CALL_TEST_LOGIC_RESET,
+    C_AJI_MOCK_CALL_DELAY,
+    C_AJI_MOCK_CALL_RUN_TEST_IDLE,
+    C_AJI_MOCK_CALL_ACCESS_IR,
+    C_AJI_MOCK_CALL_ACCESS_DR,
+    C_AJI_MOCK_CALL_ACCESS_OVERLAY,
+    C_AJI_MOCK_CALL_COUNT
+};
+
+enum c_aji_mock_state {
+    C_AJI_MOCK_STATE_TEST_LOGIC_RESET = 0,
+    C_AJI_MOCK_STATE_RUN_TEST_IDLE,
+    C_AJI_MOCK_STATE_PAUSE_DR,
+};
+
+struct c_aji_mock_stats {
+    unsigned long long calls[C_AJI_MOCK_CALL_COUNT];
+    unsigned long long round_trips; //< Number of simulated jtagd transactions
+    unsigned long long bits_scanned;
+    unsigned long long idle_visits; //< Number of times the chain went to RUN_TEST_IDLE
+    unsigned long long latency_us;  //< Total latency injected
+
+    unsigned long long dap_transactions; //< DPACC and APACC scans
+    unsigned long long dap_csw_writes;
+    unsigned long long dap_tar_writes;
+    unsigned long long dap_memory_accesses; //< DRW and BD0-BD3 accesses
+};
+
+/**
+ * Add a TAP to the end of the simulated chain.
+ * The first call replaces the default chain, which is an Arria 10
+ * FPGA TAP with one SLD node followed by its HPS DAP TAP.
+ *
+ * \param idcode IDCODE of the TAP
+ * \param irlen Length of the instruction register, in bits
+ * \return AJI_NO_ERROR, or AJI_TOO_MANY_DEVICES if the chain is full,
+ *         or AJI_IR_LENGTH_ERROR if irlen is out of range.
+ */
+AJI_ERROR c_aji_mock_add_tap(DWORD idcode, DWORD irlen);
+
+/**
+ * Add an SLD node to the SLD hub of a simulated TAP.
+ *
+ * \param tap_position Position of the TAP on the chain
+ * \param idcode Node IDCODE, as reported by the SLD hub
+ * \return AJI_NO_ERROR, or AJI_BAD_TAP_POSITION, or AJI_TOO_MANY_DEVICES
+ */
+AJI_ERROR c_aji_mock_add_node(DWORD tap_position, DWORD idcode);
+
+/**
+ * Make a simulated TAP an ADIv5 JTAG-DP, with an AHB MEM-AP at APSEL 0.
+ *
+ * With ABORT, DPACC or APACC in its IR, the DR of the TAP is the 35-bit
+ * JTAG-DP register. Every transaction is acked OK and captures the result
+ * of the previous read, or RDBUFF. CTRL/STAT acks every power-up request
+ * and never sets a sticky flag. The MEM-AP supports 8, 16 and 32-bit
+ * accesses, packed or not, with TAR auto-increment wrapping at 1KB. Its
+ * memory is memory_size bytes of zeros, repeated over the address space.
+ * Any other instruction selects the usual loopback DR.
+ *
+ * \param tap_position Position of the TAP on the chain
+ * \param memory_size Size of the memory behind the MEM-AP, in bytes
+ * \return AJI_NO_ERROR, or AJI_BAD_TAP_POSITION, or AJI_IR_LENGTH_ERROR
+ *         if the IR is not 4 bits long, or AJI_INVALID_PARAMETER, or
+ *         AJI_NO_MEMORY
+ */
+AJI_ERROR c_aji_mock_add_dap(DWORD tap_position, DWORD memory_size);
+
+/**
+ * Instruction last shifted into the IR of a simulated TAP.
+ *
+ * \param tap_position Position of the TAP on the chain
+ * \param ir Receives the instruction
+ * \return AJI_NO_ERROR, or AJI_BAD_TAP_POSITION
+ */
+AJI_ERROR c_aji_mock_get_ir(DWORD tap_position, QWORD *ir);
+
+/** State the simulated chain is in */
+enum c_aji_mock_state c_aji_mock_get_state(void);
+
+/** Number of TAPs on the simulated chain */
+DWORD c_aji_mock_get_tap_count(void);
+
+/** Set the latency injected in every simulated round trip, in microseconds */
+void c_aji_mock_set_latency(DWORD latency_us);
+DWORD c_aji_mock_get_latency(void);
+
+const struct c_aji_mock_stats* c_aji_mock_get_stats(void);
+void c_aji_mock_reset_stats(void);
+const char* c_aji_mock_call_name(enum c_aji_mock_call call);
+
+#endif //BUILD_AJI_CLIENT_MOCK
+#endif //INC_C_JTAG_CLIENT_GNUAJI_MOCK_H
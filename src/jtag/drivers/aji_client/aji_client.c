@@ -20,6 +20,7 @@
 #endif
 
 #include <time.h>
+#include <pthread.h>
 
 #include <jtag/jtag.h>
 #include <target/embeddedice.h>
@@ -30,6 +31,7 @@
 #include "jtag/jtagcore_overwrite.h"
 #include "log.h"
 #include "server/server.h"
+#include "target/target.h"
 
 #include "aji/aji.h"
 #include "aji/c_jtag_client_gnuaji.h"
@@ -38,6 +40,171 @@
 extern void jtag_tap_add(struct jtag_tap* t);
 
 
+//=================================
+// Scan batching
+//=================================
+
+/**
+ * Default maximum number of scans in a batch.
+ */
+#define AJI_CLIENT_BATCH_SIZE_DEFAULT 256
+
+/**
+ * Operations that can be batched
+ */
+enum aji_client_op {
+	AJI_CLIENT_OP_IR,      //< IR scan of a JTAG TAP
+	AJI_CLIENT_OP_OVERLAY, //< Virtual IR scan of an SLD node
+	AJI_CLIENT_OP_DR,      //< DR scan of a JTAG TAP or SLD node
+	AJI_CLIENT_OP_RUN_TEST_IDLE,
+	AJI_CLIENT_OP_DELAY,   //< Sleep, carried out by the JTAG server
+	AJI_CLIENT_OP_TEST_LOGIC_RESET,
+};
+
+/**
+ * A scan issued to the JTAG server whose captured bits have not yet
+ * been delivered to OpenOCD.
+ */
+struct aji_client_pending_scan {
+	struct scan_command *cmd; //< Only valid in the command queue issuing the scan
+	enum aji_client_op op;
+	bool  tap_is_sld;
+	DWORD flags;        //< #AJI_DR_FLAGS for #AJI_CLIENT_OP_DR
+	DWORD bit_count;    //< or the number of cycles for #AJI_CLIENT_OP_RUN_TEST_IDLE,
+	                    //< or microseconds for #AJI_CLIENT_OP_DELAY
+	BYTE *write_buffer; //< In the scratch arena, valid until the batch is flushed
+	BYTE *read_buffer;  //< In the scratch arena, receives the captured bits on flush
+	bool  has_capture;  //< Captured bits returned in \c capture
+	DWORD instruction;  //< Overlay value written by #AJI_CLIENT_OP_OVERLAY
+	DWORD capture;      //< Captured overlay value
+};
+
+/**
+ * Runs of scans targeting the same #AJI_OPEN_ID.
+ *
+ * When batching is enabled, the TAP is locked with #AJI_PACK_MANUAL
+ * so the JTAG server only receives the scans, and returns the captured
+ * bits, when the batch is flushed with c_aji_flush(). That
+ * replaces one server round trip per scan with one per batch.
+ */
+struct aji_client_batch {
+	unsigned int max_scans; //< 0 disables batching
+	AJI_OPEN_ID open_id;    //< The node every pending scan targets
+	unsigned int count;
+	unsigned int reads;     //< pending scans with captured bits to deliver
+	struct aji_client_pending_scan *scans; //< array of size max_scans
+
+	unsigned long long batches; //< number of batches flushed
+	unsigned long long batched_scans; //< number of scans flushed in batches
+};
+static struct aji_client_batch aji_client_batch = {
+	.max_scans = AJI_CLIENT_BATCH_SIZE_DEFAULT,
+};
+
+/**
+ * Scratch memory for the write/read buffers of the scans.
+ *
+ * Buffers are carved out of the arena and all released at once when
+ * the scans using them complete. The arena only grows, to fit the
+ * largest scan seen, so it stops allocating once warmed up.
+ */
+struct aji_client_arena {
+	BYTE  *buffer;
+	size_t size;
+	size_t used;
+	size_t wanted; //< size buffers are grown to
+
+	unsigned long long scans; //< number of scans served
+	unsigned long long allocations; //< number of heap allocations made
+};
+static struct aji_client_arena aji_client_arena;
+
+
+//=================================
+// Scan pipeline
+//=================================
+
+/**
+ * Number of batches that can be handed to the pipeline worker
+ * before they are collected.
+ */
+#define AJI_CLIENT_PIPELINE_JOBS 4
+
+/**
+ * A batch handed over to the pipeline worker.
+ *
+ * The job takes the scans array and the scratch arena buffer of the
+ * batch, and gives its previous ones, already collected, back to it.
+ */
+struct aji_client_pipeline_job {
+	AJI_OPEN_ID open_id;
+	unsigned int count;
+	unsigned int reads;       //< scans with captured bits to deliver
+	unsigned int max_scans;   //< size of \c scans
+	struct aji_client_pending_scan *scans;
+	BYTE  *buffer;            //< Scratch arena buffer holding the scans' buffers
+	size_t size;
+
+	AJI_ERROR status;
+	unsigned int failed_scan; //< Scan that failed, or \c count if the flush failed
+};
+
+/**
+ * Issues batches to the JTAG server from a worker thread.
+ *
+ * Without the pipeline, OpenOCD waits for every batch to complete
+ * before it builds the next one. With it, full batches are handed over
+ * to the worker, which sends them and waits for the captured bits
+ * while OpenOCD carries on with the command queue. The captured bits
+ * are delivered to the \c in_value of the scans, and errors reported, when
+ * the command queue drains before it returns.
+ *
+ * While jobs are outstanding, the worker is the only one talking to the
+ * JTAG server, so anything else needing the server drains the pipeline
+ * first with #aji_client_batch_flush().
+ *
+ * Job \c n is in slot <tt>n % #AJI_CLIENT_PIPELINE_JOBS</tt>. Jobs
+ * [collected, ran) are complete and [ran, posted) are for the worker.
+ */
+struct aji_client_pipeline {
+	unsigned int max_scans_in_flight; //< 0 disables the pipeline
+
+	pthread_t thread;
+	bool running;
+	bool stopping;
+	pthread_mutex_t mutex;
+	pthread_cond_t job_posted;
+	pthread_cond_t job_done;
+
+	struct aji_client_pipeline_job jobs[AJI_CLIENT_PIPELINE_JOBS];
+	unsigned int posted;
+	unsigned int ran;
+	unsigned int collected;
+	unsigned int scans_in_flight; //< in jobs posted but not ran
+
+	//Only used by the main thread
+	const struct jtag_tap *tap; //< TAP of the pending scans
+	int retval; //< First job error, reported by the next drain
+
+	unsigned long long jobs_posted;
+	unsigned long long stalls;  //< number of waits for a job to complete before posting
+};
+static struct aji_client_pipeline aji_client_pipeline = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.job_posted = PTHREAD_COND_INITIALIZER,
+	.job_done = PTHREAD_COND_INITIALIZER,
+};
+
+static int aji_client_batch_flush(void);
+static int aji_client_batch_set_size(const unsigned int max_scans);
+static int aji_client_batch_submit(void);
+static int aji_client_pipeline_post(void);
+static int aji_client_pipeline_drain(void);
+static int aji_client_batch_issue(AJI_OPEN_ID open_id, struct aji_client_pending_scan *scan);
+static bool aji_client_pipeline_busy(void);
+static int aji_client_pipeline_set_depth(const unsigned int max_scans_in_flight);
+
+
 //=================================
 // Helpers
 //=================================
@@ -55,7 +222,65 @@ static char* hexdump(const uint8_t* buf, const unsigned int size)
 	return str;
 }
 
+/**
+ * Timer callback releasing the TAP lock retained by the
+ * lock session once it goes idle.
+ */
+static int aji_client_lock_session_callback(void *priv)
+{
+	if (aji_client_pipeline_busy()) {
+		return ERROR_OK; //The lock is in use by the scans in flight
+	}
+	jtagservice_release_idle_lock();
+	return ERROR_OK;
+}
+
+static bool aji_client_lock_session_timer_registered = false;
+
+/**
+ * Send test logic resets to the JTAG server, @see #aji_client_goto_tlr()
+ */
+static bool aji_client_test_logic_reset = false;
+
+/**
+ * (Re)register #aji_client_lock_session_callback() to run as often as
+ * the configured lock idle timeout.
+ */
+static void aji_client_register_lock_session_timer(void)
+{
+	if (aji_client_lock_session_timer_registered) {
+		target_unregister_timer_callback(aji_client_lock_session_callback, NULL);
+	}
+	target_register_timer_callback(aji_client_lock_session_callback,
+		jtagservice_get_lock_idle_timeout(), TARGET_TIMER_TYPE_PERIODIC, NULL
+	);
+	aji_client_lock_session_timer_registered = true;
+}
+
+/**
+ * jtag_examine_chain() overwrite. The JTAG server is accessed
+ * directly, so any scan in flight is completed first.
+ */
+static int aji_client_examine_chain(void)
+{
+	int retval = aji_client_batch_flush();
+	if (retval != ERROR_OK) {
+		return retval;
+	}
+	return jtagservice_jtag_examine_chain();
+}
 
+/**
+ * jtag_validate_ircapture() overwrite. See #aji_client_examine_chain()
+ */
+static int aji_client_validate_ircapture(void)
+{
+	int retval = aji_client_batch_flush();
+	if (retval != ERROR_OK) {
+		return retval;
+	}
+	return jtagservice_jtag_validate_ircapture();
+}
 
 
 
@@ -114,8 +339,18 @@ static int aji_client_init(void)
 
 	//overwrites JTAGCORE
 	struct jtagcore_overwrite* record = jtagcore_get_overwrite_record();
-	record->jtag_examine_chain = jtagservice_jtag_examine_chain;
-	record->jtag_validate_ircapture = jtagservice_jtag_validate_ircapture;
+	record->jtag_examine_chain = aji_client_examine_chain;
+	record->jtag_validate_ircapture = aji_client_validate_ircapture;
+
+	if (!aji_client_batch.scans) {
+		int retval = aji_client_batch_set_size(aji_client_batch.max_scans);
+		if (retval != ERROR_OK) {
+			jtagservice_free(JTAGSERVICE_TIMEOUT_MS);
+			return ERROR_JTAG_INIT_FAILED;
+		}
+	}
+
+	aji_client_register_lock_session_timer();
 
 	return ERROR_OK;
 
@@ -127,6 +362,19 @@ static int aji_client_quit(void)
 	record->jtag_examine_chain = NULL;
 	record->jtag_validate_ircapture = NULL;
 
+	target_unregister_timer_callback(aji_client_lock_session_callback, NULL);
+	aji_client_lock_session_timer_registered = false;
+
+	aji_client_batch_flush();
+	aji_client_pipeline_set_depth(0);
+	free(aji_client_batch.scans);
+	aji_client_batch.scans = NULL;
+	free(aji_client_arena.buffer);
+	aji_client_arena.buffer = NULL;
+	aji_client_arena.size = 0;
+	aji_client_arena.used = 0;
+	aji_client_arena.wanted = 0;
+
 	jtagservice_free(JTAGSERVICE_TIMEOUT_MS);
 
 	c_jtag_client_gnuaji_free();
@@ -140,6 +388,39 @@ static int aji_client_quit(void)
 // jtag operations
 //-----------------
 
+/**
+ * Add an operation without data, e.g. \c AJI_CLIENT_OP_RUN_TEST_IDLE,
+ * to the batch. It is queued in order with the scans, so the pipeline
+ * can carry it too.
+ *
+ * \pre #jtagservice_lock() locked the JTAG scan chain by locking
+ *      one of the TAP in the JTAG scan chain.
+ *
+ * \param op The operation
+ * \param count Its number of cycles or microseconds
+ */
+static int aji_client_queue_op(const enum aji_client_op op, const DWORD count)
+{
+	struct aji_client_batch *batch = &aji_client_batch;
+	AJI_OPEN_ID open_id = jtagservice_get_in_use_open_id();
+	if (batch->count && batch->open_id != open_id) {
+		int retval = aji_client_batch_flush();
+		if (retval != ERROR_OK) {
+			return retval;
+		}
+	}
+
+	struct aji_client_pending_scan unbatched_scan;
+	struct aji_client_pending_scan *scan = batch->max_scans ?
+		&batch->scans[batch->count] : &unbatched_scan;
+	memset(scan, 0, sizeof(*scan));
+	scan->op = op;
+	scan->bit_count = count;
+	return aji_client_batch_issue(open_id, scan);
+}
+
+static int aji_client_goto_tlr(void);
+
 /**
  * Go to Run-Test-Idle State. Stay there for \c cycles,
  * then go to \c state
@@ -151,11 +432,9 @@ static int aji_client_quit(void)
  *					state
  * \param state The final state the JTAG state machine is expected
  *					to go to. Currently must be set to 
- *					\c TAP_IDLE or a warning will be produced.
- * 					This request to move to \c state is actually
- *					ignored ignored because	\c jtagserv 
- *					automatically managed the JTAG state 
- *					machine
+ *					\c TAP_IDLE or \c TAP_RESET or a warning
+ *					will be produced. \c TAP_RESET is reached
+ *					with #aji_client_goto_tlr()
  */
 static int aji_client_runtest(int cycles, tap_state_t state)
 {
@@ -163,333 +442,1039 @@ static int aji_client_runtest(int cycles, tap_state_t state)
 		cycles, state, tap_state_name(state)
 	);
 
-	AJI_ERROR status = AJI_NO_ERROR;
-
-	AJI_OPEN_ID open_id = jtagservice_get_in_use_open_id();
-	status = c_aji_run_test_idle(open_id, cycles);
-	if (AJI_NO_ERROR != status) {
-		LOG_ERROR("Unexpected error setting TAPs to RUN/IDLE state." 
-			" Return status is %d (%s)",
-			status, c_aji_error_decode(status)
-		);
-	}
 	tap_set_state(TAP_IDLE); 
+	int retval = aji_client_queue_op(AJI_CLIENT_OP_RUN_TEST_IDLE, cycles);
 
-
-	if (state != TAP_IDLE) {
+	if (state == TAP_RESET) {
+		if (retval == ERROR_OK) {
+			retval = aji_client_goto_tlr();
+		}
+	} else if (state != TAP_IDLE) {
 		LOG_WARNING("Not yet support interface_jtag_add_runtest() "
 			" to finish in non TAP_IDLE state. "
 			"State %s (%d) requested", 
 			tap_state_name(state), state
 		);
 	}
-
-	return status == AJI_NO_ERROR ? ERROR_OK : ERROR_FAIL;
+	return retval;
 }
 
 
 /**
  * Go to TLR (Test Logic Reset) State
  *
+ * By default, OpenOCD is only told \c TAP_RESET was reached:
+ * (1) jtagserv.exe automatically manages the internal JTAG state.
+ *     One of the things it does is to cycle through the TLR state
+ *     automatically, making the request redundant.
+ * (2) Several AJI clients connected to the same JTAG scan chain is
+ *     the norm for our users. Resetting the chain would also reset
+ *     the IR and SLD hub of the TAPs the other clients use. jtagserv
+ *     ignores the request anyway while another client uses the chain.
+ *
+ * With "aji_client test_logic_reset on", the test logic reset is
+ * queued with the scans, so it takes no round trip of its own.
+ *
  * \pre #jtagservice_lock() locked the JTAG scan chain by locking
  *      one of the TAP in the JTAG scan chain.
  */
 static int aji_client_goto_tlr(void)
 {
-
 	LOG_DEBUG_IO("(from %s to %s)", tap_state_name(tap_get_state()),
 		  tap_state_name(TAP_RESET));
 
-	/*
-	 The code below are working, but disabled because
-	 (1) jtagserv.exe automatically managers the internal JTAG State.
-	 	 One of the thing it does is to cycle through the TLR state
-		 automatically. Making this function redundant
-	 (2) In testing, it is found that when another AJI Client is connected
-		 to the same JTAG Scan Chain, we will consistently take the
-		 "Ignore call to set TAPs to TLR state ..." path meaning
-		 we do not move the JTAG state machine to TLR. To have multiple
-		 AJI Clients connecting to the same JTAG Scan Chain is the norm
-		 for our user.
-	 */
-	LOG_DEBUG("No need to perform TLR request. The server manages JTAG states");
 	tap_set_state(TAP_RESET); //Lie to OpenOCD that TAP_RESET state was reached.
-	return ERROR_OK;
-
-	/*
-	 The code below are working, See previous comment on why it is redundant
-	 */
-	/*
-	AJI_ERROR status = AJI_NO_ERROR;
-
-	AJI_OPEN_ID open_id =jtagservice_get_in_use_tap_open_id();
-	assert(open_id); // i.e., not NULL
-	status = c_aji_test_logic_reset(open_id);
-	if (AJI_NO_ERROR == status) {
-		tap_set_state(TAP_RESET);
-	} else if (AJI_CHAIN_IN_USE == status) {
-		LOG_WARNING("Ignoring call to set TAPs to TLR state after IR scan."
-		" Someone else is using the scan chain."
-
-		);
-		tap_set_state(TAP_RESET); //Lie to OpenOCD that TAP_RESET state was reached.
-		status = AJI_NO_ERROR;
-	} else {
-		LOG_ERROR("Unexpected error setting TAPs to TLR state. Return status is %d (%s)",
-			status, c_aji_error_decode(status)
-		);
+	if (!aji_client_test_logic_reset) {
+		LOG_DEBUG_IO("No need to perform TLR request. The server manages JTAG states");
+		return ERROR_OK;
 	}
-
-	return status == AJI_NO_ERROR ? ERROR_OK : ERROR_FAIL;
-	*/
+	return aji_client_queue_op(AJI_CLIENT_OP_TEST_LOGIC_RESET, 0);
 }
 
 
 /**
- * Build I/O buffers from \c cmd
- *
- * \param cmd The \c scan_command to extract data from
- * \param bit_count On output, the number of data bits required by \c cmd.
- * \param write_buffer On Output, a buffer of at least \c bit_count bits
- *             containing the data to be written to the TAP pointed to by \c cmd.
- *             If NULL, no data write  is needed.
- *             caller to free the memory after use.
- * \param read_buffer On Output, a buffer of at least \c bit_count bits
- *             filled with zero to receive data from the TAP pointed to by \c cmd
- *             If NULL, no data read is needed.
- *             caller to free the memory after use.
+ * Clock \c num_cycles in the current stable state, with TMS held
+ * so the state does not change.
  *
- * \return #ERROR_OK success
- * \return #ERROR_FAIL if there is a problem
+ * jtagd can only do that in \c TAP_IDLE, with a run-test-idle.
+ * In \c TAP_RESET and \c TAP_DRPAUSE, the clocks have no effect
+ * so are skipped.
  */
-static int aji_client_build_buffers(
-	const struct scan_command *const cmd,
-	DWORD *bit_count,
-	BYTE **write_buffer,
-	BYTE **read_buffer
-){
-	struct scan_command mock_cmd = {
-		.ir_scan = cmd->ir_scan,
-		.fields = cmd->tap_fields,
-		.num_fields = cmd->num_tap_fields
-	};
-	*bit_count = jtag_scan_size(&mock_cmd);
-
-	*write_buffer = NULL;
-	int req = jtag_build_buffer(&mock_cmd, write_buffer);
-	if(req) {
-		if(*write_buffer == NULL) {
-			LOG_ERROR("Insufficient memory for write buffer");
-			return ERROR_FAIL;
-		}
-	} else {
-		free(*write_buffer);
-		*write_buffer = NULL;
-	}
+static int aji_client_stableclocks(int num_cycles)
+{
+	tap_state_t state = tap_get_state();
+	LOG_DEBUG_IO("%s(num_cycles=%i, state=%s)", __func__,
+		num_cycles, tap_state_name(state)
+	);
 
-	*read_buffer = NULL;
-	req = 0;
-	for (int i = 0; i < cmd->num_tap_fields; i++) {
-		if (cmd->tap_fields[i].in_value) {
-			req += cmd->tap_fields[i].num_bits;
-		}
+	if (TAP_RESET == state || TAP_DRPAUSE == state) {
+		return ERROR_OK;
 	}
-	if(req) {
-		*read_buffer = calloc(1, DIV_ROUND_UP(*bit_count, 8));
-		if(*read_buffer == NULL) {
-			LOG_ERROR("Insufficient memory for read buffer");
-			return ERROR_FAIL;
-		}
-	} else {
-		*read_buffer = NULL;
+	if (TAP_IDLE != state) {
+		LOG_ERROR("Cannot clock in state %s. Only supported in %s, %s and %s",
+			tap_state_name(state), tap_state_name(TAP_IDLE),
+			tap_state_name(TAP_RESET), tap_state_name(TAP_DRPAUSE)
+		);
+		return ERROR_JTAG_NOT_STABLE_STATE;
 	}
-
-	return ERROR_OK;
+	return aji_client_queue_op(AJI_CLIENT_OP_RUN_TEST_IDLE, num_cycles);
 }
 
-static int aji_client_read_buffer(
-	BYTE *read_buffer,
-	const struct scan_command *cmd
-){
-	struct scan_command mock_cmd = {
-		.ir_scan = cmd->ir_scan,
-		.fields = cmd->tap_fields,
-		.num_fields = cmd->num_tap_fields
-	};
-	return jtag_read_buffer(read_buffer, &mock_cmd);
+/**
+ * Sleep for \c us microseconds.
+ *
+ * The JTAG server waits between the operations before and after
+ * the sleep, so the host does not block and the batch is not broken.
+ */
+static int aji_client_sleep(uint32_t us)
+{
+	LOG_DEBUG_IO("%s(us=%lu)", __func__, (unsigned long) us);
+	return aji_client_queue_op(AJI_CLIENT_OP_DELAY, us);
 }
 
 /**
- * Handles IR and DR scans
+ * Follow a sequence of states, or TMS bits, as jtagd allows.
  *
- * \pre #jtagservice_lock() locked the required TAP
+ * jtagd manages the JTAG state machine and cannot be driven through
+ * arbitrary states. A path reaching \c TAP_RESET is a test logic reset,
+ * see #aji_client_goto_tlr(), and one ending in \c TAP_IDLE is a
+ * run-test-idle of the number of clocks spent in \c TAP_IDLE.
  *
- * \param cmd Contains the detail about the scan operation
+ * \c TAP_DRPAUSE is only reached at the end of a DR scan, and jtagd
+ * never parks in \c TAP_IRPAUSE. A path staying in the PAUSE state the
+ * TAP is already in is accepted, since clocks there have no effect.
+ * Moving into a PAUSE state is not supported.
+ *
+ * \param path The states, one per TCK
+ * \param num_states Number of states in \c path
  */
-static int aji_client_scan(struct scan_command *const cmd)
+static int aji_client_follow_path(const tap_state_t *path, int num_states)
 {
-	DWORD bit_count = 0;
-	BYTE *write_buffer = NULL,
-		 *read_buffer = NULL;
-	char *log_buf = NULL;
-
-	aji_client_build_buffers(cmd, &bit_count, &write_buffer, &read_buffer);
-
-	if(write_buffer) {
-		log_buf = hexdump(write_buffer, DIV_ROUND_UP(bit_count, 8));
-		LOG_DEBUG_IO("%s(scan=%s%s, type=OUT, bits=%lu, buf=[%s], end_state=%d)", __func__,
-			cmd->tap_is_sld ? "Virtual " : "",
-			cmd->ir_scan ? "IRSCAN" : "DRSCAN",
-			(long unsigned) bit_count, log_buf, cmd->end_state
-		);
-		free(log_buf);
-	} else {
-		LOG_DEBUG_IO("%s(scan=%s%s, type=OUT, no write,  end_state=%d)", __func__,
-			cmd->tap_is_sld ? "Virtual " : "",
-			cmd->ir_scan ? "IRSCAN" : "DRSCAN",
-			cmd->end_state
-		);
+	if (!num_states) {
+		return ERROR_OK;
 	}
 
-
-	AJI_ERROR status = AJI_NO_ERROR;
-	AJI_OPEN_ID open_id = jtagservice_get_in_use_open_id();
-
-	if(cmd->ir_scan) {
-		//LIMITATION: Max IR length is 32 bit has it has to fit into a DWORD
-		//  since c_aji_access_ir, a.k.a. aji_access_ir(DWORD)
-		//  Cannot be relaxed even if c_aji_access_ir_a(), a.k.a. 
-		//  aji_access_ir(BYTE) version, is used because that function also
-		//  translate back to c_aji_access_ir()
-		//
-		//TODO: use c_aji_access_ir_a(), i.e. aji_acess_ir(BYTE) to avoid
-		//  having to translate  write_buffer -> instruction and
-		//  capture -> read_buffer explicitly
-
-
-		DWORD instruction = 0;
-		for (DWORD i = 0; i < (bit_count + 7) / 8; i++) {
-			instruction |= write_buffer[i] << (i * 8);
+	//Only what comes after the last test logic reset matters
+	int start = 0;
+	for (int i = 0; i < num_states; ++i) {
+		if (TAP_RESET == path[i]) {
+			start = i + 1;
 		}
-
-		DWORD capture = 0;
-		if(cmd->tap_is_sld) {
-			status = c_aji_access_overlay(open_id, instruction, read_buffer ? &capture : NULL);
-		} else {
-			status = c_aji_access_ir(
-				open_id, instruction, read_buffer ? &capture : NULL, 0);
+	}
+	if (start) {
+		int retval = aji_client_goto_tlr();
+		if (retval != ERROR_OK) {
+			return retval;
 		}
+	}
 
-		if (read_buffer) {
-			for (DWORD i = 0; i < (bit_count + 7) / 8; i++) {
-				read_buffer[i] = (BYTE)(capture >> (i * 8));
-			}
+	tap_state_t end_state = path[num_states - 1];
+	if (TAP_RESET == end_state) {
+		return ERROR_OK;
+	}
+	if (TAP_DRPAUSE == end_state || TAP_IRPAUSE == end_state) {
+		bool stays = !start;
+		for (int i = 0; stays && i < num_states; ++i) {
+			stays = path[i] == tap_get_state();
 		}
-	} else {
-		c_aji_access_dr(
-				open_id, bit_count, AJI_DR_UNUSED_X,
-				0, write_buffer ? bit_count : 0, write_buffer,
-				0, read_buffer ? bit_count : 0, read_buffer
-		);
-	} //end else-if (cmd->ir_scan)
-
-	if(status != AJI_NO_ERROR) {
-		LOG_ERROR("Failure to access %s%s register. Return Status is %d (%s)",
-			cmd->tap_is_sld ? "Virtual " : "",
-			cmd->ir_scan? "IRSCAN" : "DRSCAN",
-			status, c_aji_error_decode(status)
+		if (stays) {
+			return ERROR_OK;
+		}
+		LOG_ERROR("Cannot move to state %s. The JTAG server only ends a DR scan "
+			"in %s, so use it as the end state of the scan instead",
+			tap_state_name(end_state), tap_state_name(TAP_DRPAUSE)
 		);
-		if (write_buffer) 	{ free(write_buffer); }
-		if (read_buffer) 	{ free(read_buffer);  }
-		return ERROR_FAIL;
+		return ERROR_JTAG_TRANSITION_INVALID;
 	}
-
-
-	if(read_buffer) {
-		log_buf = hexdump(read_buffer, DIV_ROUND_UP(bit_count, 8));
-		LOG_DEBUG_IO("%s(scan=%s%s, type=IN, bits=%lu, buf=[%s], end_state=%d)", __func__,
-			cmd->tap_is_sld ? "Virtual " : "",
-			cmd->ir_scan ? "IRSCAN" : "DRSCAN",
-			(long unsigned) bit_count, log_buf, cmd->end_state
-		);
-		free(log_buf);
-	} else {
-		LOG_DEBUG_IO("%s(scan=%s%s, type=IN, no read,  end_state=%d)", __func__,
-			cmd->tap_is_sld ? "Virtual " : "",
-			cmd->ir_scan ? "IRSCAN" : "DRSCAN",
-			cmd->end_state
+	if (TAP_IDLE != end_state) {
+		LOG_ERROR("Cannot move to state %s. Only %s and %s are supported",
+			tap_state_name(end_state), tap_state_name(TAP_IDLE), tap_state_name(TAP_RESET)
 		);
+		return ERROR_JTAG_TRANSITION_INVALID;
 	}
 
-	if(read_buffer) {
-		aji_client_read_buffer(read_buffer, cmd);
+	DWORD idle_clocks = 0;
+	for (int i = start; i < num_states; ++i) {
+		if (TAP_IDLE == path[i]) {
+			++idle_clocks;
+		}
 	}
+	tap_set_state(TAP_IDLE);
+	return aji_client_queue_op(AJI_CLIENT_OP_RUN_TEST_IDLE, idle_clocks);
+}
 
+static int aji_client_pathmove(const struct pathmove_command *cmd)
+{
+	LOG_DEBUG_IO("%s(num_states=%d, end_state=%s)", __func__,
+		cmd->num_states,
+		tap_state_name(cmd->path[cmd->num_states - 1])
+	);
+	return aji_client_follow_path(cmd->path, cmd->num_states);
+}
 
-	if (write_buffer) 	{ free(write_buffer); }
-	if (read_buffer) 	{ free(read_buffer);  }
-
-
+/**
+ * Clock out raw TMS bits, by following the states they go through.
+ * See #aji_client_follow_path()
+ */
+static int aji_client_tms(const struct tms_command *cmd)
+{
+	LOG_DEBUG_IO("%s(num_bits=%d)", __func__, cmd->num_bits);
 
-	if (TAP_IDLE != cmd->end_state) {
-		LOG_WARNING("%s%s not yet handle transition to state other than TAP_IDLE(%d)." \
-				    " Requested state is %s(%d)", 
-					cmd->tap_is_sld ? "Virtual " : "",
-					cmd->ir_scan? "IRSCAN" : "DRSCAN",
-					TAP_IDLE, tap_state_name(cmd->end_state), cmd->end_state
-		);
-		assert(0); //deliberately assert() to be able to see where the error is, if it occurs
+	tap_state_t *path = malloc(cmd->num_bits * sizeof(tap_state_t));
+	if (!path && cmd->num_bits) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
 	}
 
-	//// Let jtagserv manages the JTAG state instead of setting it manually
-	/* status = c_aji_run_test_idle(open_id, 2);
-	 if (AJI_NO_ERROR != status) {
-		LOG_WARNING("Failed to go to TAP_IDLE after IR register write");
+	tap_state_t state = tap_get_state();
+	for (unsigned int i = 0; i < cmd->num_bits; ++i) {
+		state = tap_state_transition(state, buf_get_u32(cmd->bits, i, 1));
+		path[i] = state;
 	}
-	*/
 
-	tap_set_state(TAP_IDLE); //Faking move to TAP_IDLE
-	return ERROR_OK;
+	int retval = aji_client_follow_path(path, cmd->num_bits);
+	free(path);
+	return retval;
 }
 
+
 /**
- * Find the next tap used in a jtag_command sequence
- *
- * \param cmds The list of commands to search
- * \param next_tap On output,the next tap if found. 
- *                 if not, no modification to the input value, 
+ * Number of bits \c cmd scans through the TAP it targets
  */
-static void find_next_active_tap(
-				const struct jtag_command *cmds, 
-					  struct jtag_tap **next_tap ) 
+static DWORD aji_client_scan_size(const struct scan_command *const cmd)
 {
-	for(const struct jtag_command *candidate = cmds; 
-								   candidate != NULL; 
-								   candidate = candidate->next) {
-		if(candidate->type == JTAG_SCAN) {
-			(*next_tap) = candidate->cmd.scan->tap;
-			return;
-		}
+	DWORD bit_count = 0;
+	for (int i = 0; i < cmd->num_tap_fields; i++) {
+		bit_count += cmd->tap_fields[i].num_bits;
 	}
+	return bit_count;
 }
 
-int aji_client_execute_queue(void)
+/**
+ * Make sure the scratch arena has \c bytes available.
+ *
+ * Buffers in the arena are in use until the scans using them
+ * complete, so the pending batch is submitted to free up the arena
+ * before it is grown.
+ *
+ * \param bytes Number of bytes needed
+ *
+ * \return #ERROR_OK success
+ * \return #ERROR_FAIL if there is a problem
+ */
+static int aji_client_arena_reserve(const size_t bytes)
 {
-	struct jtag_command *cmd;
-	int ret = ERROR_OK;
-
-	if(jtag_command_queue == NULL) {
+	struct aji_client_arena *arena = &aji_client_arena;
+	if (arena->used + bytes <= arena->size) {
 		return ERROR_OK;
 	}
 
-	struct jtag_tap *tap = NULL;
-	for (cmd = jtag_command_queue; ret == ERROR_OK && cmd != NULL;
-		 cmd = cmd->next) {
+	//Doubling, so a batch of scans soon fit without flushing early
+	arena->wanted = MAX(arena->wanted, 2 * (arena->used + bytes));
 
-		keep_alive();
+	int retval = aji_client_batch_submit();
+	if (retval != ERROR_OK) {
+		return retval;
+	}
+	arena->used = 0;
+
+	//The pipeline may have handed over a buffer that is still small
+	size_t size = arena->wanted;
+	if (size <= arena->size) {
+		return ERROR_OK;
+	}
+	//Nothing in the arena is in use any more, so nothing needs copying
+	free(arena->buffer);
+	arena->buffer = malloc(size);
+	if (!arena->buffer) {
+		arena->size = 0;
+		LOG_ERROR("Insufficient memory for %zu bytes of scan buffers", size);
+		return ERROR_FAIL;
+	}
+	arena->size = size;
+	++arena->allocations;
+	return ERROR_OK;
+}
+
+/**
+ * Carve \c bytes out of the scratch arena.
+ *
+ * \pre #aji_client_arena_reserve() made enough room.
+ */
+static BYTE *aji_client_arena_alloc(const size_t bytes)
+{
+	struct aji_client_arena *arena = &aji_client_arena;
+	assert(arena->used + bytes <= arena->size);
+
+	BYTE *buffer = arena->buffer + arena->used;
+	arena->used += bytes;
+	return buffer;
+}
+
+/**
+ * Build I/O buffers from \c cmd
+ *
+ * \pre #aji_client_arena_reserve() made room for twice
+ *      <tt>DIV_ROUND_UP(bit_count, 8)</tt> bytes.
+ *
+ * \param cmd The \c scan_command to extract data from
+ * \param bit_count The number of data bits required by \c cmd.
+ * \param write_buffer On Output, a buffer of at least \c bit_count bits
+ *             containing the data to be written to the TAP pointed to by \c cmd.
+ *             If NULL, no data write  is needed.
+ *             Owned by the scratch arena.
+ * \param read_buffer On Output, a buffer of at least \c bit_count bits
+ *             filled with zero to receive data from the TAP pointed to by \c cmd
+ *             If NULL, no data read is needed.
+ *             Owned by the scratch arena.
+ */
+static void aji_client_build_buffers(
+	const struct scan_command *const cmd,
+	const DWORD bit_count,
+	BYTE **write_buffer,
+	BYTE **read_buffer
+){
+	const size_t bytes = DIV_ROUND_UP(bit_count, 8);
+
+	*write_buffer = NULL;
+	if (bit_count) {
+		*write_buffer = aji_client_arena_alloc(bytes);
+		memset(*write_buffer, 0, bytes);
+
+		DWORD offset = 0;
+		for (int i = 0; i < cmd->num_tap_fields; i++) {
+			const struct scan_field *field = &cmd->tap_fields[i];
+			if (field->out_value) {
+				buf_set_buf(field->out_value, 0, *write_buffer, offset, field->num_bits);
+			}
+			offset += field->num_bits;
+		}
+	}
+
+	*read_buffer = NULL;
+	for (int i = 0; i < cmd->num_tap_fields; i++) {
+		if (cmd->tap_fields[i].in_value) {
+			*read_buffer = aji_client_arena_alloc(bytes);
+			memset(*read_buffer, 0, bytes);
+			break;
+		}
+	}
+}
+
+/**
+ * Copy the captured bits in \c read_buffer to the
+ * \c in_value of the fields of \c cmd.
+ *
+ * Equivalent to jtag_read_buffer() without the intermediate
+ * heap allocation for each field.
+ */
+static int aji_client_read_buffer(
+	const BYTE *read_buffer,
+	const struct scan_command *cmd
+){
+	DWORD offset = 0;
+	for (int i = 0; i < cmd->num_tap_fields; i++) {
+		const struct scan_field *field = &cmd->tap_fields[i];
+		if (field->in_value) {
+			buf_set_buf(read_buffer, offset, field->in_value, 0, field->num_bits);
+
+			//As jtag_read_buffer(), clear bits beyond num_bits
+			unsigned int trailing_bits = field->num_bits % 8;
+			if (trailing_bits) {
+				field->in_value[field->num_bits / 8] &= (1 << trailing_bits) - 1;
+			}
+		}
+		offset += field->num_bits;
+	}
+	return ERROR_OK;
+}
+
+
+//-----------------
+// Scan batching
+//-----------------
+
+/**
+ * Name of the operation done by \c scan, for logging
+ */
+static const char *aji_client_scan_name(const struct aji_client_pending_scan *scan)
+{
+	switch (scan->op) {
+	case AJI_CLIENT_OP_IR:
+	case AJI_CLIENT_OP_OVERLAY:
+		return "IRSCAN";
+	case AJI_CLIENT_OP_DR:
+		return "DRSCAN";
+	case AJI_CLIENT_OP_RUN_TEST_IDLE:
+		return "RUNTEST";
+	case AJI_CLIENT_OP_DELAY:
+		return "SLEEP";
+	case AJI_CLIENT_OP_TEST_LOGIC_RESET:
+		return "TLR_RESET";
+	}
+	return "UNKNOWN";
+}
+
+/**
+ * Send \c scan to the JTAG server.
+ *
+ * Does not log, so the pipeline worker can call it.
+ */
+static AJI_ERROR aji_client_issue_scan(
+	AJI_OPEN_ID open_id,
+	struct aji_client_pending_scan *scan
+){
+	switch (scan->op) {
+	case AJI_CLIENT_OP_IR:
+		//Byte array access so the buffers need no packing/unpacking.
+		//LIMITATION: libaji_client translates c_aji_access_ir_a(),
+		//  a.k.a. aji_access_ir(BYTE), back to c_aji_access_ir(),
+		//  a.k.a. aji_access_ir(DWORD), so the JTAG server still
+		//  limits the IR to 32 bits. The driver takes any IR length.
+		return c_aji_access_ir_a(
+			open_id, scan->bit_count, scan->write_buffer, scan->read_buffer, 0);
+	case AJI_CLIENT_OP_OVERLAY:
+		return c_aji_access_overlay(open_id, scan->instruction,
+			scan->read_buffer ? &scan->capture : NULL);
+	case AJI_CLIENT_OP_DR:
+		return c_aji_access_dr(
+				open_id, scan->bit_count, scan->flags,
+				0, scan->write_buffer ? scan->bit_count : 0, scan->write_buffer,
+				0, scan->read_buffer ? scan->bit_count : 0, scan->read_buffer
+		);
+	case AJI_CLIENT_OP_RUN_TEST_IDLE:
+		return c_aji_run_test_idle(open_id, scan->bit_count);
+	case AJI_CLIENT_OP_DELAY:
+		return c_aji_delay(open_id, scan->bit_count);
+	case AJI_CLIENT_OP_TEST_LOGIC_RESET: {
+		//Someone else is using the scan chain, see #aji_client_goto_tlr()
+		AJI_ERROR status = c_aji_test_logic_reset(open_id);
+		return AJI_CHAIN_IN_USE == status ? AJI_NO_ERROR : status;
+	}
+	}
+	return AJI_INVALID_PARAMETER;
+}
+
+static void aji_client_log_scan_failure(
+	const struct aji_client_pending_scan *scan,
+	const AJI_ERROR status
+){
+	if (scan->op == AJI_CLIENT_OP_RUN_TEST_IDLE) {
+		LOG_ERROR("Unexpected error setting TAPs to RUN/IDLE state."
+			" Return status is %d (%s)",
+			status, c_aji_error_decode(status)
+		);
+		return;
+	}
+	if (scan->op == AJI_CLIENT_OP_TEST_LOGIC_RESET) {
+		LOG_ERROR("Unexpected error setting TAPs to TLR state."
+			" Return status is %d (%s)",
+			status, c_aji_error_decode(status)
+		);
+		return;
+	}
+	if (scan->op == AJI_CLIENT_OP_DELAY) {
+		LOG_ERROR("Unexpected error sleeping %lu us. Return status is %d (%s)",
+			(unsigned long) scan->bit_count, status, c_aji_error_decode(status)
+		);
+		return;
+	}
+	LOG_ERROR("Failure to access %s%s register. Return Status is %d (%s)",
+		scan->tap_is_sld ? "Virtual " : "",
+		aji_client_scan_name(scan),
+		status, c_aji_error_decode(status)
+	);
+}
+
+/**
+ * Deliver the captured bits of \c scan to OpenOCD.
+ *
+ * \param scan The completed scan.
+ */
+static int aji_client_complete_scan(struct aji_client_pending_scan *scan)
+{
+	if (!scan->read_buffer) {
+		//scan->cmd may belong to a command queue already freed
+		LOG_DEBUG_IO("%s(scan=%s%s, type=IN, no read)", __func__,
+			scan->tap_is_sld ? "Virtual " : "",
+			aji_client_scan_name(scan)
+		);
+		return ERROR_OK;
+	}
+
+	const struct scan_command *cmd = scan->cmd;
+	if (scan->has_capture) {
+		for (DWORD i = 0; i < DIV_ROUND_UP(scan->bit_count, 8); i++) {
+			scan->read_buffer[i] = (BYTE)(scan->capture >> (i * 8));
+		}
+	}
+
+	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
+		char *log_buf = hexdump(scan->read_buffer, DIV_ROUND_UP(scan->bit_count, 8));
+		LOG_DEBUG_IO("%s(scan=%s%s, type=IN, bits=%lu, buf=[%s], end_state=%d)", __func__,
+			cmd->tap_is_sld ? "Virtual " : "",
+			cmd->ir_scan ? "IRSCAN" : "DRSCAN",
+			(long unsigned) scan->bit_count, log_buf, cmd->end_state
+		);
+		free(log_buf);
+	}
+
+	return aji_client_read_buffer(scan->read_buffer, cmd);
+}
+
+/**
+ * Send the pending scans to the JTAG server and deliver
+ * their captured bits.
+ *
+ * With the pipeline enabled, also waits for all the scans in flight.
+ */
+static int aji_client_batch_flush(void)
+{
+	struct aji_client_batch *batch = &aji_client_batch;
+	if (aji_client_pipeline.running) {
+		return aji_client_pipeline_drain();
+	}
+	if (batch->count == 0) {
+		return ERROR_OK;
+	}
+
+	int retval = ERROR_OK;
+	AJI_ERROR status = c_aji_flush(batch->open_id);
+	if (AJI_NO_ERROR != status) {
+		LOG_ERROR("Failure to flush %u scans. Return Status is %d (%s)",
+			batch->count, status, c_aji_error_decode(status)
+		);
+		retval = ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; retval == ERROR_OK && i < batch->count; ++i) {
+		retval = aji_client_complete_scan(&batch->scans[i]);
+	}
+
+	++batch->batches;
+	batch->batched_scans += batch->count;
+	batch->count = 0;
+	batch->reads = 0;
+	batch->open_id = NULL;
+	aji_client_arena.used = 0;
+	return retval;
+}
+
+/**
+ * Make room in a full batch, handing it over to the pipeline
+ * if enabled, without waiting for it to complete.
+ */
+static int aji_client_batch_submit(void)
+{
+	if (aji_client_pipeline.running) {
+		return aji_client_pipeline_post();
+	}
+	return aji_client_batch_flush();
+}
+
+/**
+ * Set the maximum number of scans in a batch.
+ *
+ * \param max_scans Maximum number of scans, 0 to disable batching
+ */
+static int aji_client_batch_set_size(const unsigned int max_scans)
+{
+	struct aji_client_batch *batch = &aji_client_batch;
+	int retval = aji_client_batch_flush();
+
+	struct aji_client_pending_scan *scans = NULL;
+	if (max_scans) {
+		scans = calloc(max_scans, sizeof(struct aji_client_pending_scan));
+		if (!scans) {
+			LOG_ERROR("Insufficient memory for %u batched scans", max_scans);
+			return ERROR_FAIL;
+		}
+	}
+	free(batch->scans);
+	batch->scans = scans;
+	batch->max_scans = max_scans;
+
+	jtagservice_set_pack_style(max_scans ? AJI_PACK_MANUAL : AJI_PACK_AUTO);
+
+	//The pipeline only runs with batching
+	int pipeline_retval = aji_client_pipeline_set_depth(
+		aji_client_pipeline.max_scans_in_flight);
+	return retval != ERROR_OK ? retval : pipeline_retval;
+}
+
+/**
+ * Add \c scan, built in the next slot of the batch, or outside of it
+ * if batching is disabled, to the batch.
+ *
+ * Without the pipeline, \c scan is sent to the JTAG server straight away.
+ * The server holds on to it until the batch is flushed.
+ */
+static int aji_client_batch_issue(
+	AJI_OPEN_ID open_id,
+	struct aji_client_pending_scan *scan
+){
+	struct aji_client_batch *batch = &aji_client_batch;
+
+	if (!aji_client_pipeline.running) {
+		AJI_ERROR status = aji_client_issue_scan(open_id, scan);
+		if (status != AJI_NO_ERROR) {
+			aji_client_log_scan_failure(scan, status);
+			if (!batch->count) {
+				aji_client_arena.used = 0;
+			}
+			return ERROR_FAIL;
+		}
+
+		if (!batch->max_scans) {
+			int retval = aji_client_complete_scan(scan);
+			aji_client_arena.used = 0;
+			return retval;
+		}
+	}
+
+	batch->open_id = open_id;
+	if (scan->read_buffer) {
+		++batch->reads;
+	}
+	++batch->count;
+	if (batch->count == batch->max_scans) {
+		return aji_client_batch_submit();
+	}
+	return ERROR_OK;
+}
+
+/**
+ * Handles IR and DR scans
+ *
+ * If batching is enabled, the captured bits are only delivered
+ * by #aji_client_batch_flush().
+ *
+ * \pre #jtagservice_lock() locked the required TAP
+ *
+ * \param cmd Contains the detail about the scan operation
+ */
+static int aji_client_scan(struct scan_command *const cmd)
+{
+	struct aji_client_batch *batch = &aji_client_batch;
+	AJI_OPEN_ID open_id = jtagservice_get_in_use_open_id();
+
+	if (batch->count && batch->open_id != open_id) {
+		int retval = aji_client_batch_flush();
+		if (retval != ERROR_OK) {
+			return retval;
+		}
+	}
+
+	const DWORD bit_count = aji_client_scan_size(cmd);
+	int retval = aji_client_arena_reserve(2 * DIV_ROUND_UP(bit_count, 8));
+	if (retval != ERROR_OK) {
+		return retval;
+	}
+	++aji_client_arena.scans;
+
+	//When batching, the server writes the captured bits into
+	//the batch slot on flush, so the scan must be built in place
+	struct aji_client_pending_scan unbatched_scan;
+	struct aji_client_pending_scan *scan = batch->max_scans ?
+		&batch->scans[batch->count] : &unbatched_scan;
+	memset(scan, 0, sizeof(*scan));
+	scan->cmd = cmd;
+	scan->op = cmd->ir_scan ?
+		(cmd->tap_is_sld ? AJI_CLIENT_OP_OVERLAY : AJI_CLIENT_OP_IR) : AJI_CLIENT_OP_DR;
+	scan->tap_is_sld = cmd->tap_is_sld;
+	scan->bit_count = bit_count;
+	aji_client_build_buffers(cmd, bit_count, &scan->write_buffer, &scan->read_buffer);
+
+	if(scan->write_buffer) {
+		if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
+			char *log_buf = hexdump(scan->write_buffer, DIV_ROUND_UP(scan->bit_count, 8));
+			LOG_DEBUG_IO("%s(scan=%s%s, type=OUT, bits=%lu, buf=[%s], end_state=%d)", __func__,
+				cmd->tap_is_sld ? "Virtual " : "",
+				cmd->ir_scan ? "IRSCAN" : "DRSCAN",
+				(long unsigned) scan->bit_count, log_buf, cmd->end_state
+			);
+			free(log_buf);
+		}
+	} else {
+		LOG_DEBUG_IO("%s(scan=%s%s, type=OUT, no write,  end_state=%d)", __func__,
+			cmd->tap_is_sld ? "Virtual " : "",
+			cmd->ir_scan ? "IRSCAN" : "DRSCAN",
+			cmd->end_state
+		);
+	}
+
+	if (scan->op == AJI_CLIENT_OP_OVERLAY) {
+		//The overlay (virtual IR) register is accessed as a DWORD
+		scan->has_capture = true;
+		if (scan->bit_count > 32) {
+			LOG_ERROR("Virtual IRSCAN of %lu bits exceeds the 32 bits supported",
+				(unsigned long) scan->bit_count
+			);
+			if (!batch->count) {
+				aji_client_arena.used = 0;
+			}
+			return ERROR_FAIL;
+		}
+		for (DWORD i = 0; i < DIV_ROUND_UP(scan->bit_count, 8); i++) {
+			scan->instruction |= scan->write_buffer[i] << (i * 8);
+		}
+	}
+
+	//jtagd can keep DR scans out of Run-Test/Idle by parking in
+	//PAUSE_DR, which takes no extra transaction
+	tap_state_t end_state = TAP_IDLE;
+	if (scan->op == AJI_CLIENT_OP_DR) {
+		scan->flags = AJI_DR_UNUSED_X;
+		if (TAP_DRPAUSE == tap_get_state()) {
+			scan->flags |= AJI_DR_START_PAUSE_DR;
+		}
+		if (TAP_DRPAUSE == cmd->end_state) {
+			scan->flags |= AJI_DR_END_PAUSE_DR;
+			end_state = TAP_DRPAUSE;
+		}
+	}
+	if (end_state != cmd->end_state) {
+		//jtagd ends every other scan in Run-Test/Idle
+		LOG_DEBUG_IO("%s%s ends in %s instead of %s",
+			cmd->tap_is_sld ? "Virtual " : "",
+			cmd->ir_scan ? "IRSCAN" : "DRSCAN",
+			tap_state_name(end_state), tap_state_name(cmd->end_state)
+		);
+	}
+	tap_set_state(end_state);
+
+	if (aji_client_pipeline.running) {
+		aji_client_pipeline.tap = cmd->tap;
+	}
+	retval = aji_client_batch_issue(open_id, scan);
+	if (retval == ERROR_OK && TAP_RESET == cmd->end_state) {
+		retval = aji_client_goto_tlr();
+	}
+	return retval;
+}
+
+//-----------------
+// Scan pipeline
+//-----------------
+
+/**
+ * Send the scans of \c job to the JTAG server and wait
+ * for their captured bits. Runs in the pipeline worker.
+ */
+static void aji_client_pipeline_run(struct aji_client_pipeline_job *job)
+{
+	job->status = AJI_NO_ERROR;
+	job->failed_scan = job->count;
+	for (unsigned int i = 0; i < job->count; ++i) {
+		job->status = aji_client_issue_scan(job->open_id, &job->scans[i]);
+		if (AJI_NO_ERROR != job->status) {
+			job->failed_scan = i;
+			return;
+		}
+	}
+	job->status = c_aji_flush(job->open_id);
+}
+
+static void *aji_client_pipeline_worker(void *arg)
+{
+	struct aji_client_pipeline *pipeline = arg;
+
+	pthread_mutex_lock(&pipeline->mutex);
+	for (;;) {
+		while (!pipeline->stopping && pipeline->ran == pipeline->posted) {
+			pthread_cond_wait(&pipeline->job_posted, &pipeline->mutex);
+		}
+		if (pipeline->ran == pipeline->posted) {
+			break; //stopping, and nothing left to run
+		}
+
+		struct aji_client_pipeline_job *job =
+			&pipeline->jobs[pipeline->ran % AJI_CLIENT_PIPELINE_JOBS];
+		pthread_mutex_unlock(&pipeline->mutex);
+		aji_client_pipeline_run(job);
+		pthread_mutex_lock(&pipeline->mutex);
+
+		pipeline->scans_in_flight -= job->count;
+		++pipeline->ran;
+		pthread_cond_broadcast(&pipeline->job_done);
+	}
+	pthread_mutex_unlock(&pipeline->mutex);
+	return NULL;
+}
+
+/**
+ * Deliver the captured bits of the completed jobs and report their errors.
+ */
+static void aji_client_pipeline_collect(void)
+{
+	struct aji_client_pipeline *pipeline = &aji_client_pipeline;
+
+	for (;;) {
+		pthread_mutex_lock(&pipeline->mutex);
+		bool done = pipeline->collected != pipeline->ran;
+		pthread_mutex_unlock(&pipeline->mutex);
+		if (!done) {
+			return;
+		}
+
+		struct aji_client_pipeline_job *job =
+			&pipeline->jobs[pipeline->collected % AJI_CLIENT_PIPELINE_JOBS];
+		if (AJI_NO_ERROR != job->status) {
+			if (job->failed_scan < job->count) {
+				aji_client_log_scan_failure(&job->scans[job->failed_scan], job->status);
+			} else {
+				LOG_ERROR("Failure to flush %u scans. Return Status is %d (%s)",
+					job->count, job->status, c_aji_error_decode(job->status)
+				);
+			}
+			pipeline->retval = ERROR_FAIL;
+		}
+
+		//Deliver the captured bits, up to the first error
+		for (unsigned int i = 0; job->reads && pipeline->retval == ERROR_OK
+				&& i < job->count; ++i) {
+			if (job->scans[i].read_buffer) {
+				pipeline->retval = aji_client_complete_scan(&job->scans[i]);
+			}
+		}
+
+		pthread_mutex_lock(&pipeline->mutex);
+		++pipeline->collected;
+		pthread_mutex_unlock(&pipeline->mutex);
+	}
+}
+
+/**
+ * Hand the batch over to the pipeline worker.
+ *
+ * Waits for a job slot, and for the scans in flight to make room
+ * for the batch if there are more than the pipeline depth.
+ */
+static int aji_client_pipeline_post(void)
+{
+	struct aji_client_pipeline *pipeline = &aji_client_pipeline;
+	struct aji_client_batch *batch = &aji_client_batch;
+	if (!batch->count) {
+		return ERROR_OK;
+	}
+
+	for (;;) {
+		aji_client_pipeline_collect();
+
+		pthread_mutex_lock(&pipeline->mutex);
+		if (pipeline->posted - pipeline->collected < AJI_CLIENT_PIPELINE_JOBS
+				&& (!pipeline->scans_in_flight
+					|| pipeline->scans_in_flight + batch->count
+						<= pipeline->max_scans_in_flight)) {
+			break;
+		}
+		++pipeline->stalls;
+		pthread_cond_wait(&pipeline->job_done, &pipeline->mutex);
+		pthread_mutex_unlock(&pipeline->mutex);
+	}
+	struct aji_client_pipeline_job *job =
+		&pipeline->jobs[pipeline->posted % AJI_CLIENT_PIPELINE_JOBS];
+	pthread_mutex_unlock(&pipeline->mutex);
+
+	//The job is collected, so its scans array can go back to the batch
+	if (job->max_scans != batch->max_scans) {
+		struct aji_client_pending_scan *scans =
+			calloc(batch->max_scans, sizeof(struct aji_client_pending_scan));
+		if (!scans) {
+			LOG_ERROR("Insufficient memory for %u batched scans", batch->max_scans);
+			return ERROR_FAIL;
+		}
+		free(job->scans);
+		job->scans = scans;
+		job->max_scans = batch->max_scans;
+	}
+
+	struct aji_client_pending_scan *scans = job->scans;
+	job->scans = batch->scans;
+	batch->scans = scans;
+
+	BYTE *buffer = job->buffer;
+	size_t size = job->size;
+	job->buffer = aji_client_arena.buffer;
+	job->size = aji_client_arena.size;
+	aji_client_arena.buffer = buffer;
+	aji_client_arena.size = size;
+	aji_client_arena.used = 0;
+
+	job->open_id = batch->open_id;
+	job->count = batch->count;
+	job->reads = batch->reads;
+	++pipeline->jobs_posted;
+	++batch->batches;
+	batch->batched_scans += batch->count;
+
+	pthread_mutex_lock(&pipeline->mutex);
+	pipeline->scans_in_flight += batch->count;
+	++pipeline->posted;
+	pthread_cond_signal(&pipeline->job_posted);
+	pthread_mutex_unlock(&pipeline->mutex);
+
+	batch->count = 0;
+	batch->reads = 0;
+	batch->open_id = NULL;
+	return ERROR_OK;
+}
+
+/**
+ * Hand the batch over to the pipeline worker and wait for all
+ * the scans in flight to complete.
+ *
+ * \return The first error from the scans since the last drain
+ */
+static int aji_client_pipeline_drain(void)
+{
+	struct aji_client_pipeline *pipeline = &aji_client_pipeline;
+	int retval = aji_client_pipeline_post();
+
+	pthread_mutex_lock(&pipeline->mutex);
+	while (pipeline->ran != pipeline->posted) {
+		pthread_cond_wait(&pipeline->job_done, &pipeline->mutex);
+	}
+	pthread_mutex_unlock(&pipeline->mutex);
+	aji_client_pipeline_collect();
+
+	if (retval == ERROR_OK) {
+		retval = pipeline->retval;
+	}
+	pipeline->retval = ERROR_OK;
+	pipeline->tap = NULL;
+	return retval;
+}
+
+/**
+ * Whether the pipeline worker still has scans to complete.
+ */
+static bool aji_client_pipeline_busy(void)
+{
+	if (!aji_client_pipeline.running) {
+		return false;
+	}
+	aji_client_pipeline_collect();
+	return aji_client_pipeline.collected != aji_client_pipeline.posted;
+}
+
+/**
+ * Set the maximum number of scans in flight in the pipeline,
+ * starting or stopping the pipeline worker as needed.
+ *
+ * \param max_scans_in_flight Maximum number of scans handed over to
+ *                            the worker but not completed. 0 disables
+ *                            the pipeline.
+ */
+static int aji_client_pipeline_set_depth(const unsigned int max_scans_in_flight)
+{
+	struct aji_client_pipeline *pipeline = &aji_client_pipeline;
+	int retval = aji_client_batch_flush();
+
+	//Batches are what is handed over to the worker
+	bool enable = max_scans_in_flight && aji_client_batch.max_scans;
+	if (enable && !pipeline->running) {
+		int err = pthread_create(&pipeline->thread, NULL,
+			aji_client_pipeline_worker, pipeline);
+		if (err) {
+			LOG_ERROR("Cannot start the scan pipeline worker (error %d)", err);
+			return ERROR_FAIL;
+		}
+		pipeline->running = true;
+	} else if (!enable && pipeline->running) {
+		pthread_mutex_lock(&pipeline->mutex);
+		pipeline->stopping = true;
+		pthread_cond_signal(&pipeline->job_posted);
+		pthread_mutex_unlock(&pipeline->mutex);
+		pthread_join(pipeline->thread, NULL);
+		pipeline->running = false;
+		pipeline->stopping = false;
+
+		for (unsigned int i = 0; i < AJI_CLIENT_PIPELINE_JOBS; ++i) {
+			struct aji_client_pipeline_job *job = &pipeline->jobs[i];
+			free(job->scans);
+			free(job->buffer);
+			memset(job, 0, sizeof(*job));
+		}
+	}
+	pipeline->max_scans_in_flight = max_scans_in_flight;
+	return retval;
+}
+
+/**
+ * Find the next tap used in a jtag_command sequence
+ *
+ * \param cmds The list of commands to search
+ * \param next_tap On output,the next tap if found. 
+ *                 if not, no modification to the input value, 
+ */
+static void find_next_active_tap(
+				const struct jtag_command *cmds, 
+					  struct jtag_tap **next_tap ) 
+{
+	for(const struct jtag_command *candidate = cmds; 
+								   candidate != NULL; 
+								   candidate = candidate->next) {
+		if(candidate->type == JTAG_SCAN) {
+			(*next_tap) = candidate->cmd.scan->tap;
+			return;
+		}
+	}
+}
+
+/**
+ * Lock \c tap for the commands that follow.
+ *
+ * The pending scans are completed first, unless they are in the
+ * pipeline for \c tap, which stays locked.
+ */
+static int aji_client_lock(const struct jtag_tap *tap)
+{
+	if (!aji_client_pipeline.running || tap != aji_client_pipeline.tap) {
+		int retval = aji_client_batch_flush();
+		if (retval != ERROR_OK) {
+			return retval;
+		}
+	}
+	jtagservice_lock(tap);
+	return ERROR_OK;
+}
+
+int aji_client_execute_queue(void)
+{
+	struct jtag_command *cmd;
+	int ret = ERROR_OK;
 
-		find_next_active_tap(cmd, &tap);
-		jtagservice_lock(tap);
+	if(jtag_command_queue == NULL) {
+		return ERROR_OK;
+	}
+
+	//Only (re)lock when the TAP changes, so each TAP is
+	//locked once per run of commands targeting it.
+	struct jtag_tap *tap = NULL;
+	bool locked = false;
+	for (cmd = jtag_command_queue; ret == ERROR_OK && cmd != NULL;
+		 cmd = cmd->next) {
+
+		keep_alive();
+
+		if (cmd->type == JTAG_SCAN) {
+			if (!locked || cmd->cmd.scan->tap != tap) {
+				tap = cmd->cmd.scan->tap;
+				ret = aji_client_lock(tap);
+				if (ret != ERROR_OK) {
+					break;
+				}
+				locked = true;
+			}
+		} else if (!locked) {
+			find_next_active_tap(cmd, &tap);
+			ret = aji_client_lock(tap);
+			if (ret != ERROR_OK) {
+				break;
+			}
+			locked = true;
+		}
 
 		switch (cmd->type) {
 		case JTAG_RESET:
@@ -500,41 +1485,25 @@ int aji_client_execute_queue(void)
 			//aji_client_reset(cmd->cmd.reset->trst, cmd->cmd.reset->srst);
 			break;
 		case JTAG_RUNTEST:
-			aji_client_runtest(
+			ret = aji_client_runtest(
 				cmd->cmd.runtest->num_cycles,
 				cmd->cmd.runtest->end_state
 			);
 			break;
 		case JTAG_STABLECLOCKS:
-			LOG_ERROR("Not yet coded JTAG_STABLECLOCKS(num_cycles=%d)", 
-					  cmd->cmd.stableclocks->num_cycles
-			);
-			//aji_client_stableclocks(cmd->cmd.stableclocks->num_cycles);
+			ret = aji_client_stableclocks(cmd->cmd.stableclocks->num_cycles);
 			break;
 		case JTAG_TLR_RESET:
-			aji_client_goto_tlr();
+			ret = aji_client_goto_tlr();
 			break;
 		case JTAG_PATHMOVE:
-			LOG_ERROR(
-				"Ignoring JTAG_PATHMOVE(numstate=%d, first_state=0x%x, end_state=0x%x)",
-				cmd->cmd.pathmove->num_states, 
-				cmd->cmd.pathmove->path[0], 
-				cmd->cmd.pathmove->path[cmd->cmd.pathmove->num_states-1]
-			);
-			//aji_client_path_move(cmd->cmd.pathmove);
-			assert(0); //deliberately assert() to be able to see where the error is, if it occurs
+			ret = aji_client_pathmove(cmd->cmd.pathmove);
 			break;
 		case JTAG_TMS:
-			LOG_ERROR("Not yet coded JTAG_TMS(num_bits=%d)",
-					  cmd->cmd.tms->num_bits
-			);
-			//aji_client_tms(cmd->cmd.tms);
-			assert(0); //deliberately assert() to be able to see where the error is, if it occurs
+			ret = aji_client_tms(cmd->cmd.tms);
 			break;
 		case JTAG_SLEEP:
-			LOG_ERROR("Not yet coded JTAG_SLEEP(time=%d us)", cmd->cmd.sleep->us);
-			//aji_client_usleep(cmd->cmd.sleep->us);
-			assert(0); //deliberately assert() to be able to see where the error is, if it occurs
+			ret = aji_client_sleep(cmd->cmd.sleep->us);
 			break;
 		case JTAG_SCAN:
 			ret = aji_client_scan(cmd->cmd.scan);
@@ -546,7 +1515,13 @@ int aji_client_execute_queue(void)
 			break;
 		}
 	}
-	jtagservice_unlock();
+
+	//The errors of the scans in flight belong to this command queue
+	int retval = aji_client_batch_flush();
+	if (ret == ERROR_OK) {
+		ret = retval;
+	}
+	jtagservice_release();
 	return ret;
 }
 
@@ -563,6 +1538,361 @@ static const struct command_registration vjtag_subcommand_handlers[] = {
 	COMMAND_REGISTRATION_DONE
 }; //end vjtag_subcommand_handlers
 
+COMMAND_HANDLER(aji_client_handle_lock_session_command)
+{
+	if (CMD_ARGC > 2) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	bool enable = jtagservice_get_lock_session();
+	DWORD idle_timeout_ms = jtagservice_get_lock_idle_timeout();
+	if (CMD_ARGC > 0) {
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], enable);
+	}
+	if (CMD_ARGC > 1) {
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], idle_timeout_ms);
+	}
+	int retval = aji_client_batch_flush(); //Scans in flight need their lock
+	if (retval != ERROR_OK) {
+		return retval;
+	}
+	bool timeout_changed = idle_timeout_ms != jtagservice_get_lock_idle_timeout();
+	jtagservice_set_lock_session(enable, idle_timeout_ms);
+	if (timeout_changed && aji_client_lock_session_timer_registered) {
+		aji_client_register_lock_session_timer();
+	}
+
+	command_print(CMD, "lock session is %s, idle timeout %lu ms",
+		enable ? "on" : "off", (unsigned long) idle_timeout_ms
+	);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(aji_client_handle_test_logic_reset_command)
+{
+	if (CMD_ARGC > 1) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], aji_client_test_logic_reset);
+	}
+
+	command_print(CMD, "test logic reset is %s",
+		aji_client_test_logic_reset ? "sent to the JTAG server" : "left to the JTAG server"
+	);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(aji_client_handle_batch_size_command)
+{
+	if (CMD_ARGC > 1) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	if (CMD_ARGC == 1) {
+		unsigned int max_scans;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], max_scans);
+		int retval = aji_client_batch_set_size(max_scans);
+		if (retval != ERROR_OK) {
+			return retval;
+		}
+	}
+
+	command_print(CMD, "batch size is %u scans%s", aji_client_batch.max_scans,
+		aji_client_batch.max_scans ? "" : " (disabled)"
+	);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(aji_client_handle_pipeline_command)
+{
+	if (CMD_ARGC > 1) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	if (CMD_ARGC == 1) {
+		unsigned int max_scans_in_flight;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], max_scans_in_flight);
+		int retval = aji_client_pipeline_set_depth(max_scans_in_flight);
+		if (retval != ERROR_OK) {
+			return retval;
+		}
+	}
+
+	if (!aji_client_pipeline.max_scans_in_flight) {
+		command_print(CMD, "scan pipeline is disabled");
+	} else {
+		command_print(CMD, "scan pipeline depth is %u scans%s",
+			aji_client_pipeline.max_scans_in_flight,
+			aji_client_pipeline.running ? "" : " (inactive, needs batching)"
+		);
+	}
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(aji_client_handle_discovery_cache_command)
+{
+	if (CMD_ARGC > 1) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	if (CMD_ARGC == 1) {
+		const char *path = strcmp(CMD_ARGV[0], "off") == 0 ? NULL : CMD_ARGV[0];
+		if (AJI_NO_ERROR != jtagservice_set_discovery_cache(path)) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	const char *path = jtagservice_get_discovery_cache();
+	command_print(CMD, "SLD discovery cache is %s", path ? path : "off");
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(aji_client_handle_stats_command)
+{
+	if (CMD_ARGC > 1) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0) {
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		}
+		jtagservice_reset_lock_stats();
+		aji_client_batch.batches = 0;
+		aji_client_batch.batched_scans = 0;
+		aji_client_arena.scans = 0;
+		aji_client_arena.allocations = 0;
+		aji_client_pipeline.jobs_posted = 0;
+		aji_client_pipeline.stalls = 0;
+		return ERROR_OK;
+	}
+
+	const struct jtagservice_lock_stats *lock_stats = jtagservice_get_lock_stats();
+	command_print(CMD, "lock round trips:       %llu", lock_stats->lock_round_trips);
+	command_print(CMD, "lock round trips saved: %llu", lock_stats->lock_round_trips_saved);
+	command_print(CMD, "idle lock releases:     %llu", lock_stats->idle_releases);
+	command_print(CMD, "batches flushed:        %llu", aji_client_batch.batches);
+	command_print(CMD, "scans in batches:       %llu", aji_client_batch.batched_scans);
+	command_print(CMD, "scans:                  %llu", aji_client_arena.scans);
+	command_print(CMD, "scan buffer allocations: %llu (%zu bytes)",
+		aji_client_arena.allocations, aji_client_arena.size
+	);
+	command_print(CMD, "pipeline batches:       %llu", aji_client_pipeline.jobs_posted);
+	command_print(CMD, "pipeline stalls:        %llu", aji_client_pipeline.stalls);
+	return ERROR_OK;
+}
+
+#if BUILD_AJI_CLIENT_MOCK
+COMMAND_HANDLER(aji_client_handle_mock_tap_command)
+{
+	if (CMD_ARGC != 2) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	uint32_t idcode, irlen;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], idcode);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], irlen);
+
+	AJI_ERROR status = c_aji_mock_add_tap(idcode, irlen);
+	if (AJI_NO_ERROR != status) {
+		LOG_ERROR("Cannot add simulated TAP 0x%08lX. Return status is %d (%s)",
+			(unsigned long) idcode, status, c_aji_error_decode(status)
+		);
+		return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(aji_client_handle_mock_node_command)
+{
+	if (CMD_ARGC != 2) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	uint32_t tap_position, idcode;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], tap_position);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], idcode);
+
+	AJI_ERROR status = c_aji_mock_add_node(tap_position, idcode);
+	if (AJI_NO_ERROR != status) {
+		LOG_ERROR("Cannot add simulated SLD node 0x%08lX to TAP %lu. Return status is %d (%s)",
+			(unsigned long) idcode, (unsigned long) tap_position,
+			status, c_aji_error_decode(status)
+		);
+		return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(aji_client_handle_mock_dap_command)
+{
+	if (CMD_ARGC != 2) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	uint32_t tap_position, memory_size;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], tap_position);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], memory_size);
+
+	AJI_ERROR status = c_aji_mock_add_dap(tap_position, memory_size);
+	if (AJI_NO_ERROR != status) {
+		LOG_ERROR("Cannot make simulated TAP %lu a JTAG-DP. Return status is %d (%s)",
+			(unsigned long) tap_position, status, c_aji_error_decode(status)
+		);
+		return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(aji_client_handle_mock_ir_command)
+{
+	if (CMD_ARGC != 1) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	uint32_t tap_position;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], tap_position);
+
+	QWORD ir;
+	AJI_ERROR status = c_aji_mock_get_ir(tap_position, &ir);
+	if (AJI_NO_ERROR != status) {
+		LOG_ERROR("Cannot read the IR of simulated TAP %lu. Return status is %d (%s)",
+			(unsigned long) tap_position, status, c_aji_error_decode(status)
+		);
+		return ERROR_FAIL;
+	}
+	command_print(CMD, "0x%" PRIx64, (uint64_t) ir);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(aji_client_handle_mock_state_command)
+{
+	if (CMD_ARGC != 0) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	tap_state_t state = TAP_RESET;
+	switch (c_aji_mock_get_state()) {
+	case C_AJI_MOCK_STATE_TEST_LOGIC_RESET:
+		state = TAP_RESET;
+		break;
+	case C_AJI_MOCK_STATE_RUN_TEST_IDLE:
+		state = TAP_IDLE;
+		break;
+	case C_AJI_MOCK_STATE_PAUSE_DR:
+		state = TAP_DRPAUSE;
+		break;
+	}
+	command_print(CMD, "%s", tap_state_name(state));
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(aji_client_handle_mock_latency_command)
+{
+	if (CMD_ARGC > 1) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	if (CMD_ARGC == 1) {
+		uint32_t latency_us;
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], latency_us);
+		c_aji_mock_set_latency(latency_us);
+	}
+
+	command_print(CMD, "simulated round trip latency is %lu us",
+		(unsigned long) c_aji_mock_get_latency()
+	);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(aji_client_handle_mock_stats_command)
+{
+	if (CMD_ARGC > 1) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0) {
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		}
+		c_aji_mock_reset_stats();
+		return ERROR_OK;
+	}
+
+	const struct c_aji_mock_stats *stats = c_aji_mock_get_stats();
+	for (int call = 0; call < C_AJI_MOCK_CALL_COUNT; ++call) {
+		command_print(CMD, "%-18s %llu", c_aji_mock_call_name(call), stats->calls[call]);
+	}
+	command_print(CMD, "round trips:       %llu", stats->round_trips);
+	command_print(CMD, "bits scanned:      %llu", stats->bits_scanned);
+	command_print(CMD, "idle visits:       %llu", stats->idle_visits);
+	command_print(CMD, "latency injected:  %llu us", stats->latency_us);
+	command_print(CMD, "DAP transactions:  %llu", stats->dap_transactions);
+	command_print(CMD, "DAP CSW writes:    %llu", stats->dap_csw_writes);
+	command_print(CMD, "DAP TAR writes:    %llu", stats->dap_tar_writes);
+	command_print(CMD, "DAP memory access: %llu", stats->dap_memory_accesses);
+	return ERROR_OK;
+}
+
+static const struct command_registration aji_client_mock_subcommand_handlers[] = {
+	{
+		.name = "tap",
+		.handler = &aji_client_handle_mock_tap_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Append a TAP to the simulated JTAG chain. "
+			"The first one replaces the default chain",
+		.usage = "<idcode> <irlen>",
+	},
+	{
+		.name = "node",
+		.handler = &aji_client_handle_mock_node_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Add an SLD node to the SLD hub of a simulated TAP",
+		.usage = "<tap_position> <idcode>",
+	},
+	{
+		.name = "dap",
+		.handler = &aji_client_handle_mock_dap_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Make a simulated TAP an ARM JTAG-DP with a MEM-AP "
+			"in front of memory_size bytes of memory",
+		.usage = "<tap_position> <memory_size>",
+	},
+	{
+		.name = "ir",
+		.handler = &aji_client_handle_mock_ir_command,
+		.mode = COMMAND_EXEC,
+		.help = "Show the instruction last shifted into a simulated TAP",
+		.usage = "<tap_position>",
+	},
+	{
+		.name = "state",
+		.handler = &aji_client_handle_mock_state_command,
+		.mode = COMMAND_EXEC,
+		.help = "Show the state the simulated JTAG chain is in",
+		.usage = "",
+	},
+	{
+		.name = "latency",
+		.handler = &aji_client_handle_mock_latency_command,
+		.mode = COMMAND_ANY,
+		.help = "Latency added to every simulated JTAG server round trip",
+		.usage = "[latency_us]",
+	},
+	{
+		.name = "stats",
+		.handler = &aji_client_handle_mock_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "Show or reset the simulated JTAG server call counters",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+#endif //BUILD_AJI_CLIENT_MOCK
+
 static const struct command_registration aji_client_subcommand_handlers[] = {
 	{
 		/*
@@ -578,13 +1908,68 @@ static const struct command_registration aji_client_subcommand_handlers[] = {
 		.help = "select the hardware",
 		.usage = "<name> <type>[<port>]",
 	},
+	{
+		.name = "lock_session",
+		.handler = &aji_client_handle_lock_session_command,
+		.mode = COMMAND_ANY,
+		.help = "Keep TAP/SLD node locked across command queues "
+			"until it has been idle for idle_timeout_ms",
+		.usage = "['on'|'off'] [idle_timeout_ms]",
+	},
+	{
+		.name = "test_logic_reset",
+		.handler = &aji_client_handle_test_logic_reset_command,
+		.mode = COMMAND_ANY,
+		.help = "Send test logic resets to the JTAG server instead of "
+			"leaving the JTAG state machine to it. Resets the whole chain",
+		.usage = "['on'|'off']",
+	},
+	{
+		.name = "batch_size",
+		.handler = &aji_client_handle_batch_size_command,
+		.mode = COMMAND_ANY,
+		.help = "Maximum number of scans sent to the JTAG server "
+			"in one transaction. 0 disables batching",
+		.usage = "[max_scans]",
+	},
+	{
+		.name = "pipeline",
+		.handler = &aji_client_handle_pipeline_command,
+		.mode = COMMAND_ANY,
+		.help = "Maximum number of scans handed over to a worker thread "
+			"but not completed. 0 disables the scan pipeline",
+		.usage = "[max_scans_in_flight]",
+	},
+	{
+		.name = "discovery_cache",
+		.handler = &aji_client_handle_discovery_cache_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Cache SLD node discovery in a file across sessions",
+		.usage = "[filename|'off']",
+	},
+	{
+		.name = "stats",
+		.handler = &aji_client_handle_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "Show or reset the JTAG server round trip statistics",
+		.usage = "['reset']",
+	},
+#if BUILD_AJI_CLIENT_MOCK
+	{
+		.name = "mock",
+		.mode = COMMAND_ANY,
+		.help = "Configure the simulated JTAG server",
+		.usage = "",
+		.chain = aji_client_mock_subcommand_handlers,
+	},
+#endif
 	COMMAND_REGISTRATION_DONE
 };
 
 static const struct command_registration aji_client_command_handlers[] = {
 	{
 		.name = "aji_client",
-		.mode = COMMAND_CONFIG,
+		.mode = COMMAND_ANY,
 		.help = "Perform aji_client management",
 		.usage = "",
 		.chain = aji_client_subcommand_handlers,
@@ -608,8 +1993,21 @@ static const struct command_registration aji_client_command_handlers[] = {
 };
 
 
+/**
+ * Scans that can be queued before waiting for the JTAG server:
+ * a batch, or as many as the pipeline keeps in flight.
+ */
+static unsigned aji_client_queue_depth(void)
+{
+	if (aji_client_pipeline.running) {
+		return aji_client_pipeline.max_scans_in_flight;
+	}
+	return aji_client_batch.max_scans;
+}
+
 static struct jtag_interface aji_client_interface = {
 	.execute_queue = aji_client_execute_queue,
+	.queue_depth = aji_client_queue_depth,
 };
 
 struct adapter_driver aji_client_adapter_driver = {
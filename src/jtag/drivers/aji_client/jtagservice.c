@@ -25,6 +25,7 @@
 
 #include <jtag/jtag.h>
 #include <helper/jep106.h>
+#include <helper/time_support.h>
 
 #include "log.h"
 #include "jtagservice.h"
@@ -272,8 +273,80 @@ struct jtagservice_record {
 	DWORD        in_use_hier_id_node_position;
 	AJI_HIER_ID* in_use_hier_id;
 	DWORD        in_use_hier_id_idcode;
+
+	AJI_PACK_STYLE pack_style; //< Packing used while a TAP/SLD node is locked
+
+	//Lock session
+	bool    lock_session; //< Keep the lock across command queues
+	DWORD   lock_idle_timeout_ms; //< Release the lock after this long unused
+	int64_t lock_last_used_ms; //< When the lock was last used, per timeval_ms()
+	bool    lock_carried_over; //< Lock was retained from the previous command queue
+	struct jtagservice_lock_stats lock_stats;
+
+	//Discovery cache
+	char *discovery_cache_path; //< NULL if the cache is disabled
+	bool  discovery_from_cache; //< SLD nodes came from the cache and are not verified yet
 };
-static struct jtagservice_record jtagservice;
+static struct jtagservice_record jtagservice = {
+	.in_use_device_tap_position = UINT32_MAX,
+	.pack_style = AJI_PACK_AUTO,
+	.lock_session = false,
+	.lock_idle_timeout_ms = JTAGSERVICE_LOCK_IDLE_TIMEOUT_MS,
+};
+
+static AJI_ERROR jtagservice_rescan_cached_nodes(void);
+
+/**
+ * Position of a #jtag_tap or #vjtag_tap on the chain, resolved once and
+ * kept in <tt>jtag_tap->priv</tt> so locking a TAP needs no lookup.
+ */
+struct jtagservice_tap_record {
+	bool  is_sld;     //< true for a #vjtag_tap
+	DWORD tap_index;  //< index into device_list
+	DWORD node_index; //< index into hier_ids[tap_index], UINT32_MAX for a physical TAP
+};
+
+static struct jtagservice_tap_record* jtagservice_get_tap_record(const struct jtag_tap* const tap)
+{
+	return (struct jtagservice_tap_record*) tap->priv;
+}
+
+static AJI_ERROR jtagservice_set_tap_record(struct jtag_tap* tap, const bool is_sld, const DWORD tap_index, const DWORD node_index)
+{
+	struct jtagservice_tap_record *record = jtagservice_get_tap_record(tap);
+	if (!record) {
+		record = calloc(1, sizeof(struct jtagservice_tap_record));
+		if (!record) {
+			return AJI_NO_MEMORY;
+		}
+		tap->priv = record;
+	}
+	record->is_sld = is_sld;
+	record->tap_index = tap_index;
+	record->node_index = node_index;
+	return AJI_NO_ERROR;
+}
+
+/**
+ * Forget the resolved position of the virtual taps, and of the physical
+ * TAPs too if \c all is true. They will be resolved again on next lock.
+ */
+static void jtagservice_clear_tap_records(const bool all)
+{
+	for (struct vjtag_tap* vtap = vjtag_all_taps();
+		vtap != NULL;
+		vtap = (struct vjtag_tap*)vtap->next_tap) {
+		free(vtap->priv);
+		vtap->priv = NULL;
+	}
+	if (!all) {
+		return;
+	}
+	for (struct jtag_tap* tap = jtag_all_taps(); tap != NULL; tap = tap->next_tap) {
+		free(tap->priv);
+		tap->priv = NULL;
+	}
+}
 
 
 //=====================================
@@ -470,6 +543,22 @@ static AJI_ERROR jtagservice_update_active_tap_record(
 }
 
 
+/**
+ * Account for a lock request satisfied by the lock already held.
+ *
+ * If the lock was retained from the previous command queue by
+ * the lock session, both the unlock at the end of that queue and
+ * the lock at the start of this one were avoided.
+ */
+static void jtagservice_reuse_lock(void)
+{
+	if (jtagservice.lock_carried_over) {
+		++jtagservice.lock_stats.lock_round_trips_saved;
+		jtagservice.lock_carried_over = false;
+	}
+	jtagservice.lock_last_used_ms = timeval_ms();
+}
+
 /**
  * Unlock
  */
@@ -483,6 +572,13 @@ AJI_ERROR jtagservice_unlock()
 
 	AJI_ERROR status = AJI_NO_ERROR;
 	status = c_aji_unlock(jtagservice.in_use_open_id);
+	++jtagservice.lock_stats.lock_round_trips;
+	if (jtagservice.lock_carried_over) {
+		//The deferred unlock was counted as saved but is now paid for,
+		//e.g. when idle or when another TAP is to be locked
+		--jtagservice.lock_stats.lock_round_trips_saved;
+		jtagservice.lock_carried_over = false;
+	}
 	if(AJI_NO_ERROR != status) {
 		LOG_WARNING("Cannot unlock tap %lu idcode=%lX. Returned %d (%s)",
 					(unsigned long) jtagservice.in_use_device_tap_position, 
@@ -524,6 +620,7 @@ static AJI_ERROR jtagservice_lock_jtag_tap (
 	if(    !jtagservice.is_sld 
 		&& tap_index == jtagservice.in_use_device_tap_position
 	) {
+		jtagservice_reuse_lock();
 		return AJI_NO_ERROR; //tap_index is the currenly locked device.
 	}
 
@@ -586,7 +683,8 @@ static AJI_ERROR jtagservice_lock_jtag_tap (
 		}
 	} //end if (!jtagservice.device_open_id_list[tap_index]) 
 
-	status = c_aji_lock(jtagservice.device_open_id_list[tap_index], JTAGSERVICE_TIMEOUT_MS, AJI_PACK_AUTO);
+	status = c_aji_lock(jtagservice.device_open_id_list[tap_index], JTAGSERVICE_TIMEOUT_MS, jtagservice.pack_style);
+	++jtagservice.lock_stats.lock_round_trips;
 	if(!(AJI_NO_ERROR ==  status || AJI_LOCKED == status)) { 
 		 LOG_ERROR("Cannot lock tap %lu idcode=0x%08lX. Returned %d (%s)", 
 					(unsigned long) tap_index, 
@@ -640,6 +738,7 @@ AJI_ERROR jtagservice_lock_virtual_tap(
 		&&	tap_index == jtagservice.in_use_device_tap_position
 		&&  node_index == jtagservice.in_use_hier_id_node_position
 	) {
+		jtagservice_reuse_lock();
 		return AJI_NO_ERROR; //node_index is the currenly locked device.
 	}
 
@@ -711,8 +810,9 @@ AJI_ERROR jtagservice_lock_virtual_tap(
 
 	status = c_aji_lock(jtagservice.hier_id_open_id_list[tap_index][node_index], 
 						JTAGSERVICE_TIMEOUT_MS, 
-						AJI_PACK_AUTO
+						jtagservice.pack_style
 	);
+	++jtagservice.lock_stats.lock_round_trips;
 	if(!(AJI_NO_ERROR ==  status || AJI_LOCKED == status)) { 
 		 LOG_ERROR("Cannot lock virtual tap node %lu (0x%08lX) for "
 						"tap position %lu (0x%08lX). Returned %d (%s)", 
@@ -759,6 +859,7 @@ AJI_ERROR jtagservice_lock_virtual_tap(
 static AJI_ERROR jtagservice_lock_any_tap(void)
 {
 	if(jtagservice.in_use_device_tap_position != UINT32_MAX) {
+		jtagservice_reuse_lock();
 		return AJI_NO_ERROR; //already locked something, so just return
 	} 
 
@@ -778,6 +879,82 @@ static AJI_ERROR jtagservice_lock_any_tap(void)
 }
 
 
+/**
+ * Find where \c tap is on the chain.
+ *
+ * Uses the position recorded in \c tap by #jtagservice_jtag_examine_chain(),
+ * otherwise looks it up by IDCODE and records the result.
+ *
+ * \return The position. Indices are UINT32_MAX if \c tap cannot be found.
+ */
+static struct jtagservice_tap_record jtagservice_resolve_tap(const struct jtag_tap* const tap)
+{
+	const struct jtagservice_tap_record *record = jtagservice_get_tap_record(tap);
+	if (record) {
+		return *record;
+	}
+
+	struct jtagservice_tap_record resolved = {
+		.is_sld = jtag_tap_on_all_vtaps_list(tap),
+		.tap_index = UINT32_MAX,
+		.node_index = UINT32_MAX,
+	};
+	AJI_ERROR status = AJI_NO_ERROR;
+	if (resolved.is_sld) {
+		const struct jtag_tap *parent = ((struct vjtag_tap*) tap)->parent;
+		const struct jtagservice_tap_record *parent_record = jtagservice_get_tap_record(parent);
+		if (parent_record) {
+			resolved.tap_index = parent_record->tap_index;
+		} else {
+			status = jtagservice_device_index_by_idcode(parent->idcode, &resolved.tap_index);
+		}
+		if (AJI_NO_ERROR == status) {
+			status = jtagservice_hier_id_index_by_idcode(
+				tap->idcode,
+				resolved.tap_index,
+				&resolved.node_index
+			);
+		}
+		if (AJI_NO_ERROR != status) {
+			resolved.node_index = UINT32_MAX;
+			return resolved;
+		}
+	} else {
+		status = jtagservice_device_index_by_idcode(tap->idcode, &resolved.tap_index);
+		if (AJI_NO_ERROR != status) {
+			return resolved;
+		}
+	}
+
+	jtagservice_set_tap_record((struct jtag_tap*) tap, resolved.is_sld, resolved.tap_index, resolved.node_index);
+	return resolved;
+}
+
+/**
+ * Resolve \c tap and lock it.
+ *
+ * \sa jtagservice_lock()
+ */
+static AJI_ERROR jtagservice_lock_tap(const struct jtag_tap* const tap)
+{
+	if (!tap) {
+		return jtagservice_lock_any_tap(); //hardware index is not used and set to zero
+	}
+
+	struct jtagservice_tap_record record = jtagservice_resolve_tap(tap);
+	if (!record.is_sld) {
+		return jtagservice_lock_jtag_tap(0, record.tap_index);
+	}
+
+	AJI_ERROR status = jtagservice_lock_virtual_tap(0, record.tap_index, record.node_index);
+	if (AJI_NO_ERROR != status && AJI_NO_ERROR == jtagservice_rescan_cached_nodes()) {
+		//Cached SLD node is stale, look it up again
+		record = jtagservice_resolve_tap(tap);
+		status = jtagservice_lock_virtual_tap(0, record.tap_index, record.node_index);
+	}
+	return status;
+}
+
 /**
  * Lock the required \c tap.
  *
@@ -797,33 +974,95 @@ static AJI_ERROR jtagservice_lock_any_tap(void)
  */
 AJI_ERROR jtagservice_lock(const struct jtag_tap* const tap)
 {
-	if(tap && jtag_tap_on_all_vtaps_list(tap)) {
-		DWORD tap_index = UINT32_MAX;
-		jtagservice_device_index_by_idcode(
-			((struct vjtag_tap*) tap)->parent->idcode,
-			&tap_index
-		); //Not checking return status because it should pass
+	AJI_ERROR status = jtagservice_lock_tap(tap);
 
-		DWORD sld_index = UINT32_MAX;
-		jtagservice_hier_id_index_by_idcode(
-			tap->idcode,
-			tap_index,
-			&sld_index
-		); //Not checking return status because it should pass
+	//A lock carried over from the previous command queue but not
+	//reused had been replaced, so the unlock was only deferred.
+	jtagservice.lock_carried_over = false;
+	jtagservice.lock_last_used_ms = timeval_ms();
+	return status;
+}
 
-		return jtagservice_lock_virtual_tap(0, tap_index, sld_index);
+
+void jtagservice_set_pack_style(const AJI_PACK_STYLE pack_style)
+{
+	if (pack_style == jtagservice.pack_style) {
+		return;
 	}
 
-	if(tap) {
-		DWORD tap_index = UINT32_MAX;
-		jtagservice_device_index_by_idcode(
-			tap->idcode,
-			&tap_index
-		); //Not checking return status because it should pass
+	//Pack style only takes effect on the next lock
+	jtagservice_unlock();
+	jtagservice.pack_style = pack_style;
+}
+
+
+//=====================================
+// Lock session
+//=====================================
+
+void jtagservice_set_lock_session(const bool enable, const DWORD idle_timeout_ms)
+{
+	jtagservice.lock_session = enable;
+	jtagservice.lock_idle_timeout_ms = idle_timeout_ms;
 
-		return jtagservice_lock_jtag_tap(0, tap_index);
+	if (!enable && jtagservice.lock_carried_over) {
+		//Lock retained from the previous command queue is no longer wanted
+		jtagservice_unlock();
+	}
+}
+
+bool jtagservice_get_lock_session(void)
+{
+	return jtagservice.lock_session;
+}
+
+DWORD jtagservice_get_lock_idle_timeout(void)
+{
+	return jtagservice.lock_idle_timeout_ms;
+}
+
+AJI_ERROR jtagservice_release(void)
+{
+	if (UINT32_MAX == jtagservice.in_use_device_tap_position) {
+		return AJI_NO_ERROR; //nothing to release
 	}
-	return jtagservice_lock_any_tap(); //hardware index is not used and set to zero
+
+	if (!jtagservice.lock_session) {
+		return jtagservice_unlock();
+	}
+
+	++jtagservice.lock_stats.lock_round_trips_saved; //deferred unlock
+	jtagservice.lock_carried_over = true;
+	jtagservice.lock_last_used_ms = timeval_ms();
+	return AJI_NO_ERROR;
+}
+
+AJI_ERROR jtagservice_release_idle_lock(void)
+{
+	if (!jtagservice.lock_carried_over) {
+		return AJI_NO_ERROR; //Either nothing locked or a command queue is in progress
+	}
+
+	if (timeval_ms() - jtagservice.lock_last_used_ms
+			< (int64_t) jtagservice.lock_idle_timeout_ms) {
+		return AJI_NO_ERROR;
+	}
+
+	LOG_DEBUG_IO("Releasing idle lock on tap %lu",
+		(unsigned long) jtagservice.in_use_device_tap_position
+	);
+	++jtagservice.lock_stats.idle_releases;
+	return jtagservice_unlock();
+}
+
+const struct jtagservice_lock_stats* jtagservice_get_lock_stats(void)
+{
+	return &jtagservice.lock_stats;
+}
+
+void jtagservice_reset_lock_stats(void)
+{
+	memset(&jtagservice.lock_stats, 0, sizeof(jtagservice.lock_stats));
 }
 
 
@@ -909,10 +1148,15 @@ static bool vjtag_examine_chain_match_tap(struct vjtag_tap* vtap) {
 	AJI_ERROR status = AJI_NO_ERROR;
 
 	DWORD tap_index = -1;
-	status = jtagservice_device_index_by_idcode(
-		vtap->parent->idcode,
-		&tap_index
-	);
+	const struct jtagservice_tap_record *parent_record = jtagservice_get_tap_record(vtap->parent);
+	if (parent_record) {
+		tap_index = parent_record->tap_index;
+	} else {
+		status = jtagservice_device_index_by_idcode(
+			vtap->parent->idcode,
+			&tap_index
+		);
+	}
 	if (AJI_NO_ERROR != status) {
 		jtag_examine_chain_display(
 			LOG_LVL_ERROR, "UNEXPECTED",
@@ -933,6 +1177,14 @@ static bool vjtag_examine_chain_match_tap(struct vjtag_tap* vtap) {
 		&node_index
 	);
 
+	if (AJI_NO_ERROR != status && AJI_NO_ERROR == jtagservice_rescan_cached_nodes()) {
+		status = jtagservice_hier_id_index_by_idcode(
+			vtap->idcode,
+			tap_index,
+			&node_index
+		);
+	}
+
 	if (AJI_NO_ERROR != status) {
 		LOG_ERROR("Cannot find virtual tap %s (0x%08l" PRIX32 "). Return status is %d (%s)",
 			vtap->dotted_name, (unsigned long)vtap->expected_ids[0],
@@ -944,6 +1196,7 @@ static bool vjtag_examine_chain_match_tap(struct vjtag_tap* vtap) {
 	LOG_INFO("Virtual Tap/SLD node 0x%08lX found at tap position %lu vtap position %lu",
 		(unsigned long)vtap->expected_ids[0], (unsigned long)tap_index, (unsigned long)node_index
 	);
+	jtagservice_set_tap_record((struct jtag_tap*) vtap, true, tap_index, node_index);
 	return true;
 }
 
@@ -1005,6 +1258,10 @@ int jtagservice_jtag_examine_chain(void)
 		/* ensure the TAP ID matches what was expected */
 		if (!jtag_examine_chain_match_tap(tap))
 			retval = ERROR_JTAG_INIT_SOFT_FAIL;
+
+		if (AJI_NO_ERROR != jtagservice_set_tap_record(tap, false, t, UINT32_MAX)) {
+			return ERROR_JTAG_INIT_FAILED;
+		}
 	} //end for t
 
 	if (AJI_NO_ERROR != retval && ERROR_JTAG_INIT_SOFT_FAIL != retval) {
@@ -1163,6 +1420,13 @@ AJI_ERROR  jtagservice_free(DWORD timeout)
 {
 	AJI_ERROR retval = AJI_NO_ERROR;
 	AJI_ERROR status = AJI_NO_ERROR;
+
+	//Lock session might still be holding a lock
+	if (jtagservice.lock_carried_over) {
+		jtagservice_unlock();
+	}
+
+	jtagservice_clear_tap_records(true);
 	status = jtagservice_free_tap(timeout);
 	if (status) {
 		retval = status;
@@ -1176,6 +1440,7 @@ AJI_ERROR  jtagservice_free(DWORD timeout)
 	if (status) {
 		retval = status;
 	}
+	jtagservice_set_discovery_cache(NULL);
 
 	return status;
 }
@@ -1409,6 +1674,441 @@ AJI_ERROR jtagservice_scan_for_cables(void)
 	return status;
 }
 
+//=====================================
+// SLD discovery and its cache
+//=====================================
+
+#define JTAGSERVICE_CACHE_LINE_MAX 4096
+
+/**
+ * Enumerate the SLD nodes of one TAP.
+ *
+ * @pre The chain is locked.
+ * @pos On success, \c hier_ids, \c hub_infos and \c hier_id_n
+ *      are filled for \c tap_position. On failure, \c hier_id_n is 0.
+ */
+static AJI_ERROR jtagservice_scan_for_nodes(AJI_CHAIN_ID chain_id, DWORD tap_position)
+{
+	AJI_ERROR status = AJI_NO_ERROR;
+
+	free(jtagservice.hier_ids[tap_position]);
+	free(jtagservice.hub_infos[tap_position]);
+	jtagservice.hier_ids[tap_position] = NULL;
+	jtagservice.hub_infos[tap_position] = NULL;
+
+	jtagservice.hier_id_n[tap_position] = 10; //@TODO Find a good compromise for number of SLD so I don't have to call c_aji_get_nodes_b() twice.
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		jtagservice.hier_ids[tap_position] = (AJI_HIER_ID*)calloc(jtagservice.hier_id_n[tap_position], sizeof(AJI_HIER_ID));
+		jtagservice.hub_infos[tap_position] = (AJI_HUB_INFO*)calloc(jtagservice.hier_id_n[tap_position], sizeof(AJI_HUB_INFO));
+		if (NULL == jtagservice.hier_ids[tap_position] || NULL == jtagservice.hub_infos[tap_position]) {
+			LOG_ERROR("Ran out of memory for jtagservice's tap  %lu's hier_ids", (unsigned long)tap_position);
+			jtagservice.hier_id_n[tap_position] = 0;
+			return AJI_NO_MEMORY;
+		}
+
+		status = c_aji_get_nodes_bi(
+			chain_id,
+			tap_position,
+			jtagservice.hier_ids[tap_position],
+			&(jtagservice.hier_id_n[tap_position]),
+			jtagservice.hub_infos[tap_position]
+		);
+		if (AJI_TOO_MANY_DEVICES != status) {
+			break;
+		}
+		//hier_id_n now holds the number of nodes, so try again
+		free(jtagservice.hier_ids[tap_position]);
+		free(jtagservice.hub_infos[tap_position]);
+		jtagservice.hier_ids[tap_position] = NULL;
+		jtagservice.hub_infos[tap_position] = NULL;
+	}
+
+	if (AJI_NO_ERROR != status) {
+		LOG_ERROR("Problem with getting nodes for TAP position %lu. Returned %d (%s)",
+			(unsigned long)tap_position, status, c_aji_error_decode(status)
+		);
+		jtagservice.hier_id_n[tap_position] = 0;
+		return status;
+	}
+	return AJI_NO_ERROR;
+}
+
+/**
+ * Set up the per-node records of the SLD nodes of one TAP
+ * once its \c hier_ids are known.
+ */
+static AJI_ERROR jtagservice_init_nodes(DWORD tap_position)
+{
+	DWORD node_count = jtagservice.hier_id_n[tap_position];
+
+	free(jtagservice.hier_id_open_id_list[tap_position]);
+	free(jtagservice.hier_id_type_list[tap_position]);
+	jtagservice.hier_id_open_id_list[tap_position] = \
+		(AJI_OPEN_ID*)calloc(node_count ? node_count : 1, sizeof(AJI_OPEN_ID));
+	jtagservice.hier_id_type_list[tap_position] = \
+		(DEVICE_TYPE*)calloc(node_count ? node_count : 1, sizeof(DEVICE_TYPE));
+	if (NULL == jtagservice.hier_id_open_id_list[tap_position]
+		|| NULL == jtagservice.hier_id_type_list[tap_position]
+	) {
+		LOG_ERROR("Ran out of memory for jtagservice's tap  %lu's hier_ids_claims",
+			(unsigned long)tap_position
+		);
+		return AJI_NO_MEMORY;
+	}
+
+	LOG_INFO("TAP position %lu (%lX) has %lu SLD nodes",
+		(unsigned long)tap_position,
+		(unsigned long)jtagservice.device_list[tap_position].device_id,
+		(unsigned long)node_count
+	);
+	for (DWORD n = 0; n < node_count; ++n) {
+		LOG_INFO("    node %2lu idcode=%08lX position_n=%lu",
+			(unsigned long)n,
+			(unsigned long)(jtagservice.hier_ids[tap_position][n].idcode),
+			(unsigned long)(jtagservice.hier_ids[tap_position][n].position_n)
+		);
+		jtagservice.hier_id_type_list[tap_position][n] = VJTAG; //@TODO Might have to ... 
+		                                                        //... replace with  node specific claims
+	}
+	return AJI_NO_ERROR;
+}
+
+AJI_ERROR jtagservice_set_discovery_cache(const char *path)
+{
+	free(jtagservice.discovery_cache_path);
+	jtagservice.discovery_cache_path = NULL;
+	if (path) {
+		jtagservice.discovery_cache_path = strdup(path);
+		if (NULL == jtagservice.discovery_cache_path) {
+			return AJI_NO_MEMORY;
+		}
+	}
+	return AJI_NO_ERROR;
+}
+
+const char* jtagservice_get_discovery_cache(void)
+{
+	return jtagservice.discovery_cache_path;
+}
+
+/**
+ * The key of the in-use chain in the cache: its "cable" line
+ * followed by its "chain" line.
+ *
+ * \return The key, to be freed by the caller, or NULL if out of memory.
+ */
+static char* jtagservice_discovery_cache_key(void)
+{
+	const AJI_HARDWARE *hw = jtagservice.in_use_hardware;
+	size_t size = 64 + strlen(hw->hw_name) + (hw->port ? strlen(hw->port) : 0)
+				+ 9 * jtagservice.device_count;
+	char *key = malloc(size);
+	if (NULL == key) {
+		return NULL;
+	}
+
+	int length = hw->port
+		? snprintf(key, size, "cable %s [%s]\nchain %lu", hw->hw_name, hw->port, (unsigned long)jtagservice.device_count)
+		: snprintf(key, size, "cable %s\nchain %lu", hw->hw_name, (unsigned long)jtagservice.device_count);
+	for (DWORD t = 0; t < jtagservice.device_count; ++t) {
+		length += snprintf(key + length, size - length, " %08lX",
+			(unsigned long)jtagservice.device_list[t].device_id
+		);
+	}
+	snprintf(key + length, size - length, "\n");
+	return key;
+}
+
+/**
+ * Read the "cable" and "chain" lines starting at \c line into \c entry_key.
+ * \return false if \c line does not start an entry.
+ */
+static bool jtagservice_discovery_cache_read_key(FILE *file, const char *line, char *entry_key, size_t size)
+{
+	if (strncmp(line, "cable ", 6) != 0) {
+		return false;
+	}
+	size_t length = strlen(line);
+	if (length >= size) {
+		return false;
+	}
+	strcpy(entry_key, line);
+	if (NULL == fgets(entry_key + length, size - length, file)) {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Parse "node" line: idcode, position_n, positions[], bridge_idcode[]
+ * and hub_idcode[], all in hexadecimal.
+ */
+static bool jtagservice_discovery_cache_parse_node(const char *line, AJI_HIER_ID *hier_id, AJI_HUB_INFO *hub_info)
+{
+	const char *p = line + strlen("node");
+	char *end = NULL;
+	DWORD values[2 + 3 * AJI_MAX_HIERARCHICAL_HUB_DEPTH];
+	for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+		values[i] = strtoul(p, &end, 16);
+		if (end == p) {
+			return false;
+		}
+		p = end;
+	}
+
+	hier_id->idcode = values[0];
+	hier_id->position_n = values[1];
+	for (int h = 0; h < AJI_MAX_HIERARCHICAL_HUB_DEPTH; ++h) {
+		hier_id->positions[h] = values[2 + h];
+		hub_info->bridge_idcode[h] = values[2 + AJI_MAX_HIERARCHICAL_HUB_DEPTH + h];
+		hub_info->hub_idcode[h] = values[2 + 2 * AJI_MAX_HIERARCHICAL_HUB_DEPTH + h];
+	}
+	return true;
+}
+
+/**
+ * Parse the body of a cache entry, i.e. its "tap" and "node" lines, up to "end".
+ */
+static bool jtagservice_discovery_cache_parse(FILE *file)
+{
+	char line[JTAGSERVICE_CACHE_LINE_MAX];
+	DWORD tap_position = UINT32_MAX;
+	DWORD node_index = 0;
+	DWORD taps_seen = 0;
+
+	while (fgets(line, sizeof(line), file)) {
+		if (strcmp(line, "end\n") == 0) {
+			return taps_seen == jtagservice.device_count
+				&& (tap_position == UINT32_MAX || node_index == jtagservice.hier_id_n[tap_position]);
+		}
+
+		unsigned long position, node_count;
+		if (sscanf(line, "tap %lu %lu", &position, &node_count) == 2) {
+			if (position >= jtagservice.device_count || position != taps_seen) {
+				return false;
+			}
+			if (tap_position != UINT32_MAX && node_index != jtagservice.hier_id_n[tap_position]) {
+				return false;
+			}
+			tap_position = position;
+			node_index = 0;
+			++taps_seen;
+
+			jtagservice.hier_id_n[tap_position] = node_count;
+			jtagservice.hier_ids[tap_position] = (AJI_HIER_ID*)calloc(node_count ? node_count : 1, sizeof(AJI_HIER_ID));
+			jtagservice.hub_infos[tap_position] = (AJI_HUB_INFO*)calloc(node_count ? node_count : 1, sizeof(AJI_HUB_INFO));
+			if (NULL == jtagservice.hier_ids[tap_position] || NULL == jtagservice.hub_infos[tap_position]) {
+				return false;
+			}
+			continue;
+		}
+
+		if (strncmp(line, "node ", 5) == 0) {
+			if (tap_position == UINT32_MAX || node_index >= jtagservice.hier_id_n[tap_position]) {
+				return false;
+			}
+			if (!jtagservice_discovery_cache_parse_node(line,
+					&jtagservice.hier_ids[tap_position][node_index],
+					&jtagservice.hub_infos[tap_position][node_index])) {
+				return false;
+			}
+			++node_index;
+			continue;
+		}
+		return false;
+	}
+	return false; //truncated
+}
+
+/**
+ * Fill \c hier_ids, \c hub_infos and \c hier_id_n from the cache.
+ *
+ * @pre \c device_list holds the TAPs read from the chain.
+ * \return true if the chain was found in the cache.
+ */
+static bool jtagservice_discovery_cache_load(void)
+{
+	if (NULL == jtagservice.discovery_cache_path) {
+		return false;
+	}
+	FILE *file = fopen(jtagservice.discovery_cache_path, "r");
+	if (NULL == file) {
+		LOG_DEBUG("No SLD discovery cache at %s", jtagservice.discovery_cache_path);
+		return false;
+	}
+	char *key = jtagservice_discovery_cache_key();
+	if (NULL == key) {
+		fclose(file);
+		return false;
+	}
+
+	bool found = false;
+	bool loaded = false;
+	char line[JTAGSERVICE_CACHE_LINE_MAX];
+	char entry_key[2 * JTAGSERVICE_CACHE_LINE_MAX];
+	while (!found && fgets(line, sizeof(line), file)) {
+		if (jtagservice_discovery_cache_read_key(file, line, entry_key, sizeof(entry_key))
+			&& strcmp(entry_key, key) == 0
+		) {
+			found = true;
+			loaded = jtagservice_discovery_cache_parse(file);
+		}
+	}
+	fclose(file);
+	free(key);
+
+	if (found && !loaded) {
+		LOG_WARNING("Ignoring corrupted SLD discovery cache entry in %s", jtagservice.discovery_cache_path);
+		for (DWORD t = 0; t < jtagservice.device_count; ++t) {
+			free(jtagservice.hier_ids[t]);
+			free(jtagservice.hub_infos[t]);
+			jtagservice.hier_ids[t] = NULL;
+			jtagservice.hub_infos[t] = NULL;
+			jtagservice.hier_id_n[t] = 0;
+		}
+	}
+	if (loaded) {
+		LOG_INFO("Using SLD discovery cached in %s", jtagservice.discovery_cache_path);
+	}
+	return loaded;
+}
+
+/**
+ * Save the SLD nodes of the in-use chain in the cache, replacing
+ * any previous entry for the same cable and TAP IDCODEs.
+ */
+static void jtagservice_discovery_cache_save(void)
+{
+	if (NULL == jtagservice.discovery_cache_path) {
+		return;
+	}
+	char *key = jtagservice_discovery_cache_key();
+	char *temp_path = alloc_printf("%s.tmp", jtagservice.discovery_cache_path);
+	FILE *out = temp_path ? fopen(temp_path, "w") : NULL;
+	if (NULL == key || NULL == out) {
+		LOG_WARNING("Cannot write SLD discovery cache %s", jtagservice.discovery_cache_path);
+		free(key);
+		free(temp_path);
+		return;
+	}
+
+	fprintf(out, "# aji_client SLD discovery cache\n");
+
+	//Keep entries for other cables/chains
+	FILE *in = fopen(jtagservice.discovery_cache_path, "r");
+	if (in) {
+		char line[JTAGSERVICE_CACHE_LINE_MAX];
+		char entry_key[2 * JTAGSERVICE_CACHE_LINE_MAX];
+		bool skipping = false;
+		while (fgets(line, sizeof(line), in)) {
+			if (jtagservice_discovery_cache_read_key(in, line, entry_key, sizeof(entry_key))) {
+				skipping = strcmp(entry_key, key) == 0;
+				if (!skipping) {
+					fputs(entry_key, out);
+				}
+				continue;
+			}
+			if (!skipping && line[0] != '#') {
+				fputs(line, out);
+			}
+		}
+		fclose(in);
+	}
+
+	fputs(key, out);
+	for (DWORD t = 0; t < jtagservice.device_count; ++t) {
+		fprintf(out, "tap %lu %lu\n", (unsigned long)t, (unsigned long)jtagservice.hier_id_n[t]);
+		for (DWORD n = 0; n < jtagservice.hier_id_n[t]; ++n) {
+			const AJI_HIER_ID *hier_id = &jtagservice.hier_ids[t][n];
+			const AJI_HUB_INFO *hub_info = &jtagservice.hub_infos[t][n];
+			fprintf(out, "node %08lX %X", (unsigned long)hier_id->idcode, hier_id->position_n);
+			for (int h = 0; h < AJI_MAX_HIERARCHICAL_HUB_DEPTH; ++h) {
+				fprintf(out, " %X", hier_id->positions[h]);
+			}
+			for (int h = 0; h < AJI_MAX_HIERARCHICAL_HUB_DEPTH; ++h) {
+				fprintf(out, " %08lX", (unsigned long)hub_info->bridge_idcode[h]);
+			}
+			for (int h = 0; h < AJI_MAX_HIERARCHICAL_HUB_DEPTH; ++h) {
+				fprintf(out, " %08lX", (unsigned long)hub_info->hub_idcode[h]);
+			}
+			fprintf(out, "\n");
+		}
+	}
+	fprintf(out, "end\n");
+
+	bool failed = ferror(out);
+	failed = fclose(out) != 0 || failed;
+#if IS_WIN32
+	remove(jtagservice.discovery_cache_path); //rename() does not replace on Windows
+#endif
+	if (failed || rename(temp_path, jtagservice.discovery_cache_path) != 0) {
+		LOG_WARNING("Cannot write SLD discovery cache %s", jtagservice.discovery_cache_path);
+		remove(temp_path);
+	}
+	free(temp_path);
+	free(key);
+}
+
+/**
+ * Enumerate every SLD hub again because the cached SLD nodes
+ * do not match the hardware.
+ *
+ * \return #AJI_NO_ERROR if the SLD nodes were rescanned.
+ * \return #AJI_FAILURE if the SLD nodes did not come from the
+ *         cache, so there is nothing to rescan.
+ */
+static AJI_ERROR jtagservice_rescan_cached_nodes(void)
+{
+	if (!jtagservice.discovery_from_cache) {
+		return AJI_FAILURE;
+	}
+	jtagservice.discovery_from_cache = false;
+	LOG_INFO("SLD discovery cache does not match the hardware. Rescanning SLD nodes");
+	jtagservice_clear_tap_records(false);
+
+	if (UINT32_MAX != jtagservice.in_use_device_tap_position) {
+		jtagservice_unlock();
+	}
+	for (DWORD t = 0; t < jtagservice.device_count; ++t) {
+		for (DWORD n = 0; n < jtagservice.hier_id_n[t]; ++n) {
+			if (jtagservice.hier_id_open_id_list[t][n]) {
+				c_aji_close_device(jtagservice.hier_id_open_id_list[t][n]);
+				jtagservice.hier_id_open_id_list[t][n] = NULL;
+			}
+		}
+	}
+
+	AJI_ERROR status = c_aji_lock_chain(jtagservice.in_use_hardware_chain_id, JTAGSERVICE_TIMEOUT_MS);
+	if (AJI_NO_ERROR != status && AJI_LOCKED != status) {
+		LOG_ERROR("Cannot lock chain. Returned %d (%s)", status, c_aji_error_decode(status));
+		return status;
+	}
+
+	bool sld_discovery_failed = false;
+	for (DWORD t = 0; t < jtagservice.device_count; ++t) {
+		status = jtagservice_scan_for_nodes(jtagservice.in_use_hardware_chain_id, t);
+		if (AJI_NO_MEMORY == status) {
+			break;
+		}
+		if (AJI_NO_ERROR != status) {
+			sld_discovery_failed = true;
+		}
+		status = jtagservice_init_nodes(t);
+		if (AJI_NO_ERROR != status) {
+			break;
+		}
+	}
+	c_aji_unlock_chain(jtagservice.in_use_hardware_chain_id);
+	if (AJI_NO_ERROR != status) {
+		return status;
+	}
+
+	if (!sld_discovery_failed) {
+		jtagservice_discovery_cache_save();
+	}
+	return AJI_NO_ERROR;
+}
+
 /**
  * Read the TAPs on the selected cable.
  * @pre The chain is already acquired, @see select_cable()
@@ -1499,90 +2199,29 @@ AJI_ERROR jtagservice_scan_for_taps(void)
 		return AJI_NO_MEMORY;
 	}
 
+	bool from_cache = jtagservice_discovery_cache_load();
 	for (DWORD tap_position = 0; tap_position < jtagservice.device_count; ++tap_position) {
-		jtagservice.hier_id_n[tap_position] = 10; //@TODO Find a good compromise for number of SLD so I don't have to call c_aji_get_nodes_b() twice.
-		jtagservice.hier_ids[tap_position] = (AJI_HIER_ID*)calloc(jtagservice.hier_id_n[tap_position], sizeof(AJI_HIER_ID));
-		if (NULL == jtagservice.hier_ids[tap_position]) {
-			LOG_ERROR("Ran out of memory for jtagservice's tap  %lu's hier_ids", (unsigned long)tap_position);
-			return AJI_NO_MEMORY;
-		}
-		jtagservice.hub_infos[tap_position] = (AJI_HUB_INFO*)calloc(jtagservice.hier_id_n[tap_position], sizeof(AJI_HUB_INFO));
-		if (NULL == jtagservice.hub_infos[tap_position]) {
-			LOG_ERROR("Ran out of memory for jtagservice's tap  %lu's hub_info", (unsigned long)tap_position);
-			return AJI_NO_MEMORY;
-		}
-
-		status = c_aji_get_nodes_bi(
-			hw.chain_id, //could be jtagservice.in_use_hardware_chain_id,
-			tap_position,
-			jtagservice.hier_ids[tap_position],
-			&(jtagservice.hier_id_n[tap_position]),
-			jtagservice.hub_infos[tap_position]
-		);
-
-		if (AJI_TOO_MANY_DEVICES == status) {		
-			free(jtagservice.hier_ids[tap_position]);
-			jtagservice.hier_ids[tap_position] = (AJI_HIER_ID*)calloc(jtagservice.hier_id_n[tap_position], sizeof(AJI_HIER_ID));
-			if (NULL == jtagservice.hub_infos[tap_position]) {
-				LOG_ERROR("Ran out of memory for jtagservice's tap  %lu's hier_ids", (unsigned long)tap_position);
-				return AJI_NO_MEMORY;
+		if (!from_cache) {
+			status = jtagservice_scan_for_nodes(hw.chain_id, tap_position);
+			if (AJI_NO_MEMORY == status) {
+				return status;
 			}
-
-			free(jtagservice.hub_infos[tap_position]);
-			jtagservice.hub_infos[tap_position] = (AJI_HUB_INFO*)calloc(jtagservice.hier_id_n[tap_position], sizeof(AJI_HUB_INFO));
-			if (NULL == jtagservice.hub_infos[tap_position]) {
-				LOG_ERROR("Ran out of memory for jtagservice's tap  %lu's hub_info", (unsigned long)tap_position);
-				return AJI_NO_MEMORY;
+			if (AJI_NO_ERROR != status) {
+				sld_discovery_failed = true;
 			}
-
-			status = c_aji_get_nodes_bi(
-				hw.chain_id, //could be jtagservice.in_use_hardware_chain_id,
-				tap_position,
-				jtagservice.hier_ids[tap_position],
-				&(jtagservice.hier_id_n[tap_position]),
-				jtagservice.hub_infos[tap_position]
-			);
-		} // end if (AJI_TOO_MANY_DEVICES)
-
-		if (AJI_NO_ERROR != status) {
-			LOG_ERROR("Problem with getting nodes for TAP position %lu. Returned %d (%s)",
-				(unsigned long)tap_position, status, c_aji_error_decode(status)
-			);
-			sld_discovery_failed = true;
-			continue;
 		}
 
-		jtagservice.hier_id_open_id_list[tap_position] = \
-			(AJI_OPEN_ID*)calloc(jtagservice.hier_id_n[tap_position], sizeof(AJI_OPEN_ID));
-		jtagservice.hier_id_type_list[tap_position] = \
-			(DEVICE_TYPE*)calloc(jtagservice.hier_id_n[tap_position], sizeof(DEVICE_TYPE));
-		if (NULL == jtagservice.hub_infos[tap_position]) {
-			LOG_ERROR("Ran out of memory for jtagservice's tap  %lu's hier_ids_claims",
-				(unsigned long)tap_position
-			);
-			return AJI_NO_MEMORY;
+		status = jtagservice_init_nodes(tap_position);
+		if (AJI_NO_ERROR != status) {
+			return status;
 		}
-
-		LOG_INFO("TAP position %lu (%lX) has %lu SLD nodes",
-			(unsigned long)tap_position,
-			(unsigned long)jtagservice.device_list[tap_position].device_id,
-			(unsigned long)jtagservice.hier_id_n[tap_position]
-		);
-		if (jtagservice.hier_id_n[tap_position]) {
-			for (DWORD n = 0; n < jtagservice.hier_id_n[tap_position]; ++n) {
-				LOG_INFO("    node %2lu idcode=%08lX position_n=%lu",
-				    (unsigned long)n,
-				    (unsigned long)(jtagservice.hier_ids[tap_position][n].idcode),
-				    (unsigned long)(jtagservice.hier_ids[tap_position][n].position_n)
-				);
-				jtagservice.hier_id_type_list[tap_position][n] = VJTAG; //@TODO Might have to ... 
-				                                                        //... replace with  node specific claims
-			} //end for(n in jtagservice.hier_id_n[tap_position])
-		} //end if (jtagservice.hier_id_n[tap_position])
 	} //end for tap_position (SLD discovery)
+	jtagservice.discovery_from_cache = from_cache;
 
 	if (sld_discovery_failed) {
 		LOG_WARNING("Have failures in SLD discovery. See previous log entries. Continuing ...");
+	} else if (!from_cache) {
+		jtagservice_discovery_cache_save();
 	}
 
 	LOG_INFO("Discovered %lx TAP devices", (unsigned long)jtagservice.device_count);
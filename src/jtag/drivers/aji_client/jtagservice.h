@@ -58,6 +58,89 @@ AJI_ERROR jtagservice_scan_for_taps(void);
 AJI_ERROR jtagservice_lock(const struct jtag_tap* const tap);
 AJI_ERROR jtagservice_unlock(void);
 
+/**
+ * Set how operations are packed into messages to the JTAG server
+ * while a TAP/SLD node is locked.
+ *
+ * With #AJI_PACK_MANUAL, captured data are only valid after c_aji_flush().
+ * Any lock held is released so the next lock uses \c pack_style.
+ */
+void jtagservice_set_pack_style(const AJI_PACK_STYLE pack_style);
+
+//========================================
+// Lock session
+//========================================
+
+/**
+ * Default time a TAP/SLD node is kept locked after its last use
+ * when lock session is enabled.
+ */
+#define JTAGSERVICE_LOCK_IDLE_TIMEOUT_MS 100
+
+/**
+ * Statistics on the number of lock/unlock round trips to the JTAG server
+ */
+struct jtagservice_lock_stats {
+	unsigned long long lock_round_trips;   //< c_aji_lock()/c_aji_unlock() sent to the server
+	unsigned long long lock_round_trips_saved; //< round trips avoided by lock session
+	unsigned long long idle_releases;      //< locks released because they went idle
+};
+
+/**
+ * Enable/disable lock session.
+ *
+ * When lock session is enabled, the TAP/SLD node locked by
+ * #jtagservice_lock() is kept locked when a command queue
+ * completes, so the next command queue targeting the same
+ * TAP/SLD node does not need to lock it again. The lock is released
+ * by #jtagservice_release_idle_lock() once it has not been used for
+ * \c idle_timeout_ms, giving other AJI clients a chance to use the
+ * JTAG scan chain.
+ *
+ * \param enable true to enable lock session.
+ * \param idle_timeout_ms How long a lock can stay unused before it is
+ *                        released.
+ */
+void jtagservice_set_lock_session(const bool enable, const DWORD idle_timeout_ms);
+bool jtagservice_get_lock_session(void);
+DWORD jtagservice_get_lock_idle_timeout(void);
+
+/**
+ * Signal the end of a command queue.
+ *
+ * Unlock the TAP/SLD node in use, unless lock session is enabled,
+ * in which case the lock is retained.
+ */
+AJI_ERROR jtagservice_release(void);
+
+/**
+ * Unlock the TAP/SLD node in use if it had been idle for longer than
+ * the lock session idle timeout.
+ */
+AJI_ERROR jtagservice_release_idle_lock(void);
+
+const struct jtagservice_lock_stats* jtagservice_get_lock_stats(void);
+void jtagservice_reset_lock_stats(void);
+
+//========================================
+// Discovery cache
+//========================================
+
+/**
+ * Cache SLD node discovery in a file.
+ *
+ * The SLD nodes found on each TAP are saved in \c path, keyed by
+ * the cable name and the IDCODEs of the TAPs on its chain. The next
+ * #jtagservice_scan_for_taps() on the same chain reads the TAP IDCODEs
+ * only and takes the SLD nodes from the cache. The cache is checked
+ * lazily: if a cached SLD node cannot be found or opened, all SLD hubs
+ * are enumerated again and the cache is rewritten.
+ *
+ * \param path The cache file, or NULL to disable the cache.
+ */
+AJI_ERROR jtagservice_set_discovery_cache(const char *path);
+const char* jtagservice_get_discovery_cache(void);
+
 /**
  * Get the OPEN ID of the currently in use (locked) TAP/SLD node
  *
@@ -204,6 +204,14 @@ struct jtag_interface {
 	 * @returns ERROR_OK on success, or an error code on failure.
 	 */
 	int (*execute_queue)(void);
+
+	/**
+	 * Optional. Report how many scans the driver can have queued before it
+	 * has to wait for the adapter, so that callers can size their own
+	 * queues to match.
+	 * @returns the number of scans, or 0 if the driver has no such limit.
+	 */
+	unsigned (*queue_depth)(void);
 };
 
 /**
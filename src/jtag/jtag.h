@@ -566,6 +566,12 @@ void jtag_execute_queue_noclear(void);
 /** @returns the number of times the scan queue has been flushed */
 int jtag_get_flush_queue_count(void);
 
+/**
+ * @returns the number of scans the adapter driver can have queued before it
+ * has to wait for the adapter, or 0 if it doesn't tell.
+ */
+unsigned jtag_get_queue_depth(void);
+
 /** Report Tcl event to all TAPs */
 void jtag_notify_event(enum jtag_event);
 
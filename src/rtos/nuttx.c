@@ -177,7 +177,9 @@ static int nuttx_thread_packet(struct connection *connection,
 	char cmd[GDB_BUFFER_SIZE / 2 + 1] = ""; /* Extra byte for null-termination */
 
 	if (!strncmp(packet, "qRcmd", 5)) {
-		size_t len = unhexify((uint8_t *)cmd, packet + 6, sizeof(cmd));
+		/* Leave room for the null-termination, the packet may be longer
+		 * than GDB_BUFFER_SIZE */
+		size_t len = unhexify((uint8_t *)cmd, packet + 6, sizeof(cmd) - 1);
 		int offset;
 
 		if (len <= 0)
@@ -243,8 +243,10 @@ int rtos_qsymbol(struct connection *connection, char const *packet, int packet_s
 	if (!os)
 		goto done;
 
-	/* Decode any symbol name in the packet*/
-	size_t len = unhexify((uint8_t *)cur_sym, strchr(packet + 8, ':') + 1, strlen(strchr(packet + 8, ':') + 1));
+	/* Decode any symbol name in the packet, which may be longer than
+	 * GDB_BUFFER_SIZE once gdb_packet_size has been raised */
+	size_t len = unhexify((uint8_t *)cur_sym, strchr(packet + 8, ':') + 1,
+			MIN(strlen(strchr(packet + 8, ':') + 1) / 2, sizeof(cur_sym) - 1));
 	cur_sym[len] = 0;
 
 	if ((strcmp(packet, "qSymbol::") != 0) &&               /* GDB is not offering symbol lookup for the first time */
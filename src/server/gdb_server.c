@@ -66,6 +66,24 @@ struct target_desc_format {
 	uint32_t tdesc_length;
 };
 
+/* Memory read ahead of GDB memory read packets, see gdb_read_ahead_memory() */
+struct gdb_read_ahead {
+	/* the data read ahead, valid while the target memory epoch is unchanged */
+	struct target *target;
+	uint64_t mem_epoch;
+	target_addr_t address;
+	uint32_t len;
+	uint8_t *buffer;
+	size_t buffer_size;
+	/* how many packets the data read ahead served */
+	unsigned int hits;
+	/* size of the next read ahead, doubled while it pays off */
+	uint32_t window;
+	/* previous packet, to spot sequential or stack walking reads */
+	target_addr_t last_address;
+	bool last_valid;
+};
+
 /* private connection data for GDB */
 struct gdb_connection {
 	char buffer[GDB_BUFFER_SIZE + 1]; /* Extra byte for null-termination */
@@ -97,6 +115,17 @@ struct gdb_connection {
 	struct target_desc_format target_desc;
 	/* temporarily used for thread list support */
 	char *thread_list;
+	/* outgoing packets encoded on the fly, framing included, kept across
+	 * packets so that memory reads do not allocate */
+	char *out_buffer;
+	size_t out_buffer_size;
+	/* target memory read for a 'm' or 'x' packet */
+	uint8_t *mem_buffer;
+	size_t mem_buffer_size;
+	/* incoming packet, of the PacketSize advertised to GDB */
+	char *packet_buffer;
+	int packet_size;
+	struct gdb_read_ahead read_ahead;
 };
 
 #if 0
@@ -128,6 +157,24 @@ static int gdb_use_memory_map = 1;
 /* enabled by default*/
 static int gdb_flash_program = 1;
 
+/* largest packet GDB may send to new connections */
+static unsigned int gdb_packet_size = GDB_BUFFER_SIZE;
+
+/* Memory that GDB memory reads may read ahead of, in blocks of up to
+ * block_size bytes. There is none by default, as reading ahead of
+ * peripherals can have side effects. */
+struct gdb_read_ahead_region {
+	target_addr_t address;
+	target_addr_t size;
+	uint32_t block_size;
+	struct gdb_read_ahead_region *next;
+};
+
+static struct gdb_read_ahead_region *gdb_read_ahead_regions;
+
+/* smallest read ahead, grown up to the region block size */
+#define GDB_READ_AHEAD_MIN_WINDOW 256
+
 /* if set, data aborts cause an error to be reported in memory read packets
  * see the code in gdb_read_memory_packet() for further explanations.
  * Disabled by default.
@@ -357,6 +404,23 @@ static int gdb_write(struct connection *connection, void *data, int len)
 	return ERROR_SERVER_REMOTE_CLOSED;
 }
 
+static int gdb_writev(struct connection *connection,
+		const struct connection_buf *bufs, int count)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	if (gdb_con->closed)
+		return ERROR_SERVER_REMOTE_CLOSED;
+
+	int len = 0;
+	for (int i = 0; i < count; i++)
+		len += bufs[i].len;
+
+	if (connection_writev(connection, bufs, count) == len)
+		return ERROR_OK;
+	gdb_con->closed = true;
+	return ERROR_SERVER_REMOTE_CLOSED;
+}
+
 static void gdb_log_incoming_packet(char *packet)
 {
 	if (!LOG_LEVEL_IS(LOG_LVL_DEBUG))
@@ -396,18 +460,18 @@ static void gdb_log_outgoing_packet(char *packet_buf, unsigned int packet_len, u
 		LOG_DEBUG("sending packet: $%.*s#%2.2x'", packet_len, packet_buf, checksum);
 }
 
-static int gdb_put_packet_inner(struct connection *connection,
-		char *buffer, int len)
+/* Send a packet and wait for GDB to acknowledge it.
+ *
+ * If framed is set, buffer already holds the whole packet: '$', len bytes
+ * of payload and '#' followed by the checksum. Otherwise buffer only holds
+ * the payload. */
+static int gdb_send_packet(struct connection *connection,
+		char *buffer, int len, unsigned char my_checksum, bool framed)
 {
-	int i;
-	unsigned char my_checksum = 0;
 	int reply;
 	int retval;
 	struct gdb_connection *gdb_con = connection->priv;
 
-	for (i = 0; i < len; i++)
-		my_checksum += buffer[i];
-
 #ifdef _DEBUG_GDB_IO_
 	/*
 	 * At this point we should have nothing in the input queue from GDB,
@@ -436,11 +500,15 @@ static int gdb_put_packet_inner(struct connection *connection,
 #endif
 
 	while (1) {
-		gdb_log_outgoing_packet(buffer, len, my_checksum);
+		gdb_log_outgoing_packet(framed ? buffer + 1 : buffer, len, my_checksum);
 
 		char local_buffer[1024];
 		local_buffer[0] = '$';
-		if ((size_t)len + 4 <= sizeof(local_buffer)) {
+		if (framed) {
+			retval = gdb_write(connection, buffer, len + 4);
+			if (retval != ERROR_OK)
+				return retval;
+		} else if ((size_t)len + 4 <= sizeof(local_buffer)) {
 			/* performance gain on smaller packets by only a single call to gdb_write() */
 			memcpy(local_buffer + 1, buffer, len++);
 			len += snprintf(local_buffer + len, sizeof(local_buffer) - len, "#%02x", my_checksum);
@@ -449,15 +517,15 @@ static int gdb_put_packet_inner(struct connection *connection,
 				return retval;
 		} else {
 			/* larger packets are transmitted directly from caller supplied buffer
-			 * by several calls to gdb_write() to avoid dynamic allocation */
+			 * along with the framing in a single vectored write, to avoid
+			 * dynamic allocation */
 			snprintf(local_buffer + 1, sizeof(local_buffer) - 1, "#%02x", my_checksum);
-			retval = gdb_write(connection, local_buffer, 1);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = gdb_write(connection, buffer, len);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = gdb_write(connection, local_buffer + 1, 3);
+			const struct connection_buf bufs[] = {
+				{ local_buffer, 1 },
+				{ buffer, len },
+				{ local_buffer + 1, 3 },
+			};
+			retval = gdb_writev(connection, bufs, ARRAY_SIZE(bufs));
 			if (retval != ERROR_OK)
 				return retval;
 		}
@@ -512,6 +580,18 @@ static int gdb_put_packet_inner(struct connection *connection,
 	return ERROR_OK;
 }
 
+static int gdb_put_packet_inner(struct connection *connection,
+		char *buffer, int len)
+{
+	int i;
+	unsigned char my_checksum = 0;
+
+	for (i = 0; i < len; i++)
+		my_checksum += buffer[i];
+
+	return gdb_send_packet(connection, buffer, len, my_checksum, false);
+}
+
 int gdb_put_packet(struct connection *connection, char *buffer, int len)
 {
 	struct gdb_connection *gdb_con = connection->priv;
@@ -525,6 +605,82 @@ int gdb_put_packet(struct connection *connection, char *buffer, int len)
 	return retval;
 }
 
+/* Make room for size bytes in a buffer kept by the connection */
+static void *gdb_reserve_buffer(void *buffer_p, size_t *buffer_size, size_t size)
+{
+	void **buffer = buffer_p;
+	if (size > *buffer_size) {
+		void *new_buffer = realloc(*buffer, size);
+		if (!new_buffer)
+			return NULL;
+		*buffer = new_buffer;
+		*buffer_size = size;
+	}
+	return *buffer;
+}
+
+/* Send prefix followed by len bytes of data as a packet, either hex encoded
+ * or, if binary is set, escaped as for the 'X' packet.
+ *
+ * The payload is encoded and checksummed in a single pass straight into
+ * the connection's output buffer. */
+static int gdb_put_packet_encoded(struct connection *connection,
+		const char *prefix, const uint8_t *data, size_t len, bool binary)
+{
+	static const char hex_digits[] = "0123456789abcdef";
+	struct gdb_connection *gdb_con = connection->priv;
+	size_t prefix_len = strlen(prefix);
+
+	/* '$', the prefix, at most two characters per byte, '#' and checksum */
+	char *out = gdb_reserve_buffer(&gdb_con->out_buffer, &gdb_con->out_buffer_size,
+			prefix_len + 2 * len + 4);
+	if (!out) {
+		LOG_ERROR("Unable to allocate memory for a %zu bytes packet", 2 * len);
+		return ERROR_FAIL;
+	}
+
+	unsigned char my_checksum = 0;
+	char *p = out;
+	*p++ = '$';
+	for (size_t i = 0; i < prefix_len; i++) {
+		my_checksum += prefix[i];
+		*p++ = prefix[i];
+	}
+	if (binary) {
+		for (size_t i = 0; i < len; i++) {
+			char c = data[i];
+			if (c == '#' || c == '$' || c == '}' || c == '*') {
+				my_checksum += '}';
+				*p++ = '}';
+				c ^= 0x20;
+			}
+			my_checksum += c;
+			*p++ = c;
+		}
+	} else {
+		for (size_t i = 0; i < len; i++) {
+			char hi = hex_digits[data[i] >> 4];
+			char lo = hex_digits[data[i] & 0xf];
+			my_checksum += hi + lo;
+			*p++ = hi;
+			*p++ = lo;
+		}
+	}
+	int payload_len = p - out - 1;
+	*p++ = '#';
+	*p++ = hex_digits[my_checksum >> 4];
+	*p++ = hex_digits[my_checksum & 0xf];
+
+	gdb_con->busy = true;
+	int retval = gdb_send_packet(connection, out, payload_len, my_checksum, true);
+	gdb_con->busy = false;
+
+	/* we sent some data, reset timer for keep alive messages */
+	kept_alive();
+
+	return retval;
+}
+
 static inline int fetch_packet(struct connection *connection,
 		int *checksum_ok, int noack, int *len, char *buffer)
 {
@@ -983,6 +1139,19 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->sync = false;
 	gdb_connection->mem_write_error = false;
 	gdb_connection->attached = true;
+	gdb_connection->out_buffer = NULL;
+	gdb_connection->out_buffer_size = 0;
+	gdb_connection->mem_buffer = NULL;
+	gdb_connection->mem_buffer_size = 0;
+	memset(&gdb_connection->read_ahead, 0, sizeof(gdb_connection->read_ahead));
+	gdb_connection->packet_size = gdb_packet_size;
+	gdb_connection->packet_buffer = malloc(gdb_packet_size + 1); /* Extra byte for null-termination */
+	if (!gdb_connection->packet_buffer) {
+		LOG_ERROR("Unable to allocate a %u bytes GDB packet buffer", gdb_packet_size);
+		free(gdb_connection);
+		connection->priv = NULL;
+		return ERROR_FAIL;
+	}
 	gdb_connection->extended_protocol = false;
 	gdb_connection->target_desc.tdesc = NULL;
 	gdb_connection->target_desc.tdesc_length = 0;
@@ -1099,6 +1268,10 @@ static int gdb_connection_closed(struct connection *connection)
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, target);
 
+	free(gdb_connection->out_buffer);
+	free(gdb_connection->mem_buffer);
+	free(gdb_connection->packet_buffer);
+	free(gdb_connection->read_ahead.buffer);
 	free(connection->priv);
 	connection->priv = NULL;
 
@@ -1456,19 +1629,115 @@ static int gdb_error(struct connection *connection, int retval)
 	return ERROR_OK;
 }
 
+static struct gdb_read_ahead_region *gdb_find_read_ahead_region(
+		target_addr_t address, uint32_t len)
+{
+	for (struct gdb_read_ahead_region *r = gdb_read_ahead_regions; r; r = r->next) {
+		if (address >= r->address && address - r->address <= r->size - len &&
+				len <= r->size)
+			return r;
+	}
+	return NULL;
+}
+
+/* Read memory for GDB, reading ahead if it looks like more reads nearby
+ * will follow.
+ *
+ * Stack unwinding and disassembly send streams of small reads of adjacent,
+ * or nearby, memory. Once two reads in a row are close, the aligned block
+ * around the second one is read and serves the next reads. The block grows
+ * while it serves reads, and shrinks back once the reads move away.
+ *
+ * Only memory in a read-ahead region is read ahead, and the data is dropped
+ * whenever the target memory may have changed, such as when it runs. */
+static int gdb_read_ahead_memory(struct connection *connection,
+		struct target *target, target_addr_t address, uint32_t len, uint8_t *buffer)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct gdb_read_ahead *ra = &gdb_con->read_ahead;
+
+	if (!gdb_read_ahead_regions || target->state != TARGET_HALTED) {
+		ra->len = 0;
+		ra->last_valid = false;
+		return target_read_buffer(target, address, len, buffer);
+	}
+
+	if (ra->target != target || ra->mem_epoch != target->mem_epoch) {
+		ra->target = target;
+		ra->mem_epoch = target->mem_epoch;
+		ra->len = 0;
+	}
+
+	if (ra->len && address >= ra->address && address - ra->address <= ra->len - len &&
+			len <= ra->len) {
+		memcpy(buffer, ra->buffer + (address - ra->address), len);
+		ra->hits++;
+		ra->last_address = address;
+		ra->last_valid = true;
+		return ERROR_OK;
+	}
+
+	struct gdb_read_ahead_region *region = gdb_find_read_ahead_region(address, len);
+	bool nearby = region && ra->last_valid &&
+		(address > ra->last_address ? address - ra->last_address :
+			ra->last_address - address) < region->block_size;
+
+	/* Grow the read ahead while it pays off, start over once reads move away */
+	if (!nearby)
+		ra->window = GDB_READ_AHEAD_MIN_WINDOW;
+	else if (ra->hits && ra->window < region->block_size)
+		ra->window *= 2;
+	if (region)
+		ra->window = MIN(ra->window, region->block_size);
+
+	ra->last_address = address;
+	ra->last_valid = true;
+
+	if (!nearby || len >= ra->window)
+		return target_read_buffer(target, address, len, buffer);
+
+	/* The aligned block(s) around the read, within the region */
+	target_addr_t mask = ~(target_addr_t)(ra->window - 1);
+	target_addr_t start = MAX(address & mask, region->address);
+	target_addr_t end = ((address + len - 1) & mask) + ra->window - 1;
+	end = MIN(end, region->address + (region->size - 1));
+	uint32_t fetch_len = end - start + 1;
+
+	uint8_t *fetch_buffer = gdb_reserve_buffer(&ra->buffer, &ra->buffer_size, fetch_len);
+	if (!fetch_buffer)
+		return target_read_buffer(target, address, len, buffer);
+
+	ra->len = 0;
+	ra->hits = 0;
+	int retval = target_read_buffer(target, start, fetch_len, fetch_buffer);
+	/* Reading memory may have side effects on the target after all */
+	if (retval != ERROR_OK || target->mem_epoch != ra->mem_epoch)
+		return target_read_buffer(target, address, len, buffer);
+
+	LOG_DEBUG("read ahead " TARGET_ADDR_FMT ", %" PRIu32 " bytes", start, fetch_len);
+	ra->address = start;
+	ra->len = fetch_len;
+	memcpy(buffer, ra->buffer + (address - start), len);
+	return ERROR_OK;
+}
+
 /* We don't have to worry about the default 2 second timeout for GDB packets,
  * because GDB breaks up large memory reads into smaller reads.
+ *
+ * Handles both the 'm' packet, replied in hex, and the 'x' packet, replied
+ * in binary with a 'b' prefix, which halves the bytes sent to GDB.
  */
 static int gdb_read_memory_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
 	struct target *target = get_target_from_connection(connection);
+	struct gdb_connection *gdb_con = connection->priv;
 	char *separator;
 	uint64_t addr = 0;
 	uint32_t len = 0;
+	bool binary = packet[0] == 'x';
 
 	uint8_t *buffer;
-	char *hex_buffer;
 
 	int retval = ERROR_OK;
 
@@ -1485,16 +1754,25 @@ static int gdb_read_memory_packet(struct connection *connection,
 	len = strtoul(separator + 1, NULL, 16);
 
 	if (!len) {
+		if (binary) {
+			/* GDB may probe for 'x' support with an empty read */
+			gdb_put_packet(connection, "b", 1);
+			return ERROR_OK;
+		}
 		LOG_WARNING("invalid read memory packet received (len == 0)");
 		gdb_put_packet(connection, "", 0);
 		return ERROR_OK;
 	}
 
-	buffer = malloc(len);
+	buffer = gdb_reserve_buffer(&gdb_con->mem_buffer, &gdb_con->mem_buffer_size, len);
+	if (!buffer) {
+		LOG_ERROR("Unable to allocate memory for a %" PRIu32 " bytes read", len);
+		return gdb_error(connection, ERROR_FAIL);
+	}
 
 	LOG_DEBUG("addr: 0x%16.16" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
-	retval = target_read_buffer(target, addr, len, buffer);
+	retval = gdb_read_ahead_memory(connection, target, addr, len, buffer);
 
 	if ((retval != ERROR_OK) && !gdb_report_data_abort) {
 		/* TODO : Here we have to lie and send back all zero's lest stack traces won't work.
@@ -1514,19 +1792,11 @@ static int gdb_read_memory_packet(struct connection *connection,
 		retval = ERROR_OK;
 	}
 
-	if (retval == ERROR_OK) {
-		hex_buffer = malloc(len * 2 + 1);
-
-		size_t pkt_len = hexify(hex_buffer, buffer, len, len * 2 + 1);
-
-		gdb_put_packet(connection, hex_buffer, pkt_len);
-
-		free(hex_buffer);
-	} else
+	if (retval == ERROR_OK)
+		gdb_put_packet_encoded(connection, binary ? "b" : "", buffer, len, binary);
+	else
 		retval = gdb_error(connection, retval);
 
-	free(buffer);
-
 	return retval;
 }
 
@@ -1558,7 +1828,17 @@ static int gdb_write_memory_packet(struct connection *connection,
 		return ERROR_SERVER_REMOTE_CLOSED;
 	}
 
-	buffer = malloc(len);
+	if (len > (uint32_t)(packet_size - 1 - (separator - packet)) / 2) {
+		LOG_ERROR("incomplete write memory packet received, dropping connection");
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	struct gdb_connection *gdb_con = connection->priv;
+	buffer = gdb_reserve_buffer(&gdb_con->mem_buffer, &gdb_con->mem_buffer_size, len);
+	if (!buffer) {
+		LOG_ERROR("Unable to allocate memory for a %" PRIu32 " bytes write", len);
+		return gdb_error(connection, ERROR_FAIL);
+	}
 
 	LOG_DEBUG("addr: 0x%" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
@@ -1572,8 +1852,6 @@ static int gdb_write_memory_packet(struct connection *connection,
 	else
 		retval = gdb_error(connection, retval);
 
-	free(buffer);
-
 	return retval;
 }
 
@@ -2659,8 +2937,8 @@ static int gdb_query_packet(struct connection *connection,
 			&buffer,
 			&pos,
 			&size,
-			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+",
-			GDB_BUFFER_SIZE,
+			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+;binary-upload+",
+			gdb_connection->packet_size,
 			((gdb_use_memory_map == 1) && (flash_get_bank_count() > 0)) ? '+' : '-',
 			(gdb_target_desc_supported == 1) ? '+' : '-');
 
@@ -3259,14 +3537,12 @@ static void gdb_sig_halted(struct connection *connection)
 
 static int gdb_input_inner(struct connection *connection)
 {
-	/* Do not allocate this on the stack */
-	static char gdb_packet_buffer[GDB_BUFFER_SIZE + 1]; /* Extra byte for null-termination */
-
 	struct target *target;
-	char const *packet = gdb_packet_buffer;
 	int packet_size;
 	int retval;
 	struct gdb_connection *gdb_con = connection->priv;
+	char *gdb_packet_buffer = gdb_con->packet_buffer;
+	char const *packet = gdb_packet_buffer;
 	static bool warn_use_ext;
 
 	target = get_target_from_connection(connection);
@@ -3283,7 +3559,7 @@ static int gdb_input_inner(struct connection *connection)
 	 * drain the rest of the buffer.
 	 */
 	do {
-		packet_size = GDB_BUFFER_SIZE;
+		packet_size = gdb_con->packet_size;
 		retval = gdb_get_packet(connection, gdb_packet_buffer, &packet_size);
 		if (retval != ERROR_OK)
 			return retval;
@@ -3322,6 +3598,7 @@ static int gdb_input_inner(struct connection *connection)
 					retval = gdb_set_register_packet(connection, packet, packet_size);
 					break;
 				case 'm':
+				case 'x':
 					retval = gdb_read_memory_packet(connection, packet, packet_size);
 					break;
 				case 'M':
@@ -3672,6 +3949,74 @@ COMMAND_HANDLER(handle_gdb_report_data_abort_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_packet_size_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int size;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], size);
+		if (size < GDB_BUFFER_SIZE || size > GDB_MAX_PACKET_SIZE) {
+			command_print(CMD, "packet size must be between %u and %u bytes",
+				GDB_BUFFER_SIZE, GDB_MAX_PACKET_SIZE);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		gdb_packet_size = size;
+	}
+
+	command_print(CMD, "%u", gdb_packet_size);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_gdb_read_ahead_command)
+{
+	if (CMD_ARGC == 1 && !strcmp(CMD_ARGV[0], "clear")) {
+		while (gdb_read_ahead_regions) {
+			struct gdb_read_ahead_region *next = gdb_read_ahead_regions->next;
+			free(gdb_read_ahead_regions);
+			gdb_read_ahead_regions = next;
+		}
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC == 3) {
+		target_addr_t address, size;
+		uint32_t block_size;
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[1], size);
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], block_size);
+		if (!size)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		if (block_size < GDB_READ_AHEAD_MIN_WINDOW || block_size > GDB_MAX_PACKET_SIZE ||
+				(block_size & (block_size - 1))) {
+			command_print(CMD, "block size must be a power of 2 from %u to %u bytes",
+				GDB_READ_AHEAD_MIN_WINDOW, GDB_MAX_PACKET_SIZE);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+
+		struct gdb_read_ahead_region *region = malloc(sizeof(*region));
+		if (!region) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		region->address = address;
+		region->size = size;
+		region->block_size = block_size;
+		region->next = gdb_read_ahead_regions;
+		gdb_read_ahead_regions = region;
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	for (struct gdb_read_ahead_region *r = gdb_read_ahead_regions; r; r = r->next)
+		command_print(CMD, TARGET_ADDR_FMT " " TARGET_ADDR_FMT " %" PRIu32,
+			r->address, r->size, r->block_size);
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_report_register_access_error)
 {
 	if (CMD_ARGC != 1)
@@ -3802,6 +4147,22 @@ static const struct command_registration gdb_command_handlers[] = {
 		.help = "enable or disable reporting data aborts",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "gdb_packet_size",
+		.handler = handle_gdb_packet_size_command,
+		.mode = COMMAND_ANY,
+		.help = "Display or set the largest packet GDB may send, "
+			"advertised to the connections made afterwards",
+		.usage = "[bytes]"
+	},
+	{
+		.name = "gdb_read_ahead",
+		.handler = handle_gdb_read_ahead_command,
+		.mode = COMMAND_ANY,
+		.help = "Let GDB memory reads read ahead in blocks of up to block_size "
+			"bytes within a memory region, or list or clear these regions",
+		.usage = "[address size block_size | 'clear']"
+	},
 	{
 		.name = "gdb_report_register_access_error",
 		.handler = handle_gdb_report_register_access_error,
@@ -3845,4 +4206,10 @@ void gdb_service_free(void)
 {
 	free(gdb_port);
 	free(gdb_port_next);
+
+	while (gdb_read_ahead_regions) {
+		struct gdb_read_ahead_region *next = gdb_read_ahead_regions->next;
+		free(gdb_read_ahead_regions);
+		gdb_read_ahead_regions = next;
+	}
 }
@@ -33,6 +33,8 @@ struct reg;
 #include <target/target.h>
 
 #define GDB_BUFFER_SIZE 16384
+/* Largest PacketSize that can be advertised to GDB, see gdb_packet_size */
+#define GDB_MAX_PACKET_SIZE (256 * 1024)
 
 int gdb_target_add_all(struct target *target);
 int gdb_register_commands(struct command_context *command_context);
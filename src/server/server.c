@@ -45,8 +45,20 @@
 #include <netinet/tcp.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
 static struct service *services;
 
+/* Set when a service or connection comes or goes, so the event loop
+ * watches the right file descriptors */
+static bool watched_fds_changed = true;
+
 enum shutdown_reason {
 	CONTINUE_MAIN_LOOP,			/* stay in main event loop */
 	SHUTDOWN_REQUESTED,			/* set by shutdown command; exit the event loop and quit the debugger */
@@ -156,6 +168,7 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	for (p = &service->connections; *p; p = &(*p)->next)
 		;
 	*p = c;
+	watched_fds_changed = true;
 
 	if (service->max_connections != CONNECTION_LIMIT_UNLIMITED)
 		service->max_connections--;
@@ -184,6 +197,7 @@ static int remove_connection(struct service *service, struct connection *connect
 			/* delete connection */
 			*p = c->next;
 			free(c);
+			watched_fds_changed = true;
 
 			if (service->max_connections != CONNECTION_LIMIT_UNLIMITED)
 				service->max_connections++;
@@ -346,6 +360,7 @@ int add_service(char *name,
 	for (p = &services; *p; p = &(*p)->next)
 		;
 	*p = c;
+	watched_fds_changed = true;
 
 	return ERROR_OK;
 }
@@ -386,6 +401,7 @@ int remove_service(const char *name, const char *port)
 
 			free(tmp->priv);
 			free_service(tmp);
+			watched_fds_changed = true;
 
 			return ERROR_OK;
 		}
@@ -420,11 +436,223 @@ static int remove_services(void)
 	}
 
 	services = NULL;
+	watched_fds_changed = true;
 
 	return ERROR_OK;
 }
 
-int server_loop(struct command_context *command_context)
+/* Accept, or reject, a new connection on a listening service */
+static void service_accept(struct service *service, struct command_context *command_context)
+{
+	if (service->max_connections != 0)
+		add_connection(service, command_context);
+	else {
+		if (service->type == CONNECTION_TCP) {
+			struct sockaddr_in sin;
+			socklen_t address_size = sizeof(sin);
+			int tmp_fd;
+			tmp_fd = accept(service->fd,
+					(struct sockaddr *)&service->sin,
+					&address_size);
+			close_socket(tmp_fd);
+		}
+		LOG_INFO(
+			"rejected '%s' connection, no more connections allowed",
+			service->name);
+	}
+}
+
+/* Handle input on a connection, dropping it on error */
+static void connection_input(struct service *service, struct connection *c)
+{
+	int retval = service->input(c);
+	if (retval != ERROR_OK) {
+		if (service->type == CONNECTION_PIPE ||
+				service->type == CONNECTION_STDINOUT) {
+			/* if connection uses a pipe then
+			 * shutdown openocd on error */
+			shutdown_openocd = SHUTDOWN_REQUESTED;
+		}
+		remove_connection(service, c);
+		LOG_INFO("dropped '%s' connection",
+			service->name);
+	}
+}
+
+/* How long the event loop may sleep: the polling period, or less if a
+ * timer callback is due sooner */
+static int server_timeout_ms(void)
+{
+	int64_t timeout = target_timer_next_event() - timeval_ms();
+	if (timeout < 0)
+		return 0;
+	return MIN(timeout, polling_period);
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#define MAX_EPOLL_EVENTS 64
+
+/* What a file descriptor watched by epoll belongs to: a listening service,
+ * or a connection of that service */
+struct server_watch {
+	struct service *service;
+	struct connection *connection;
+};
+
+static int epoll_fd = -1;
+static struct server_watch *watches;
+static unsigned int watch_count;
+
+/* Start watching the file descriptors of all services and connections
+ * afresh. Connections come and go seldom enough for this to be cheaper
+ * than keeping track of every change, such as the stdin service handing
+ * over its descriptor to its connection. */
+static int server_watch_fds(void)
+{
+	unsigned int count = 0;
+	for (struct service *service = services; service; service = service->next) {
+		count++;
+		for (struct connection *c = service->connections; c; c = c->next)
+			count++;
+	}
+
+	struct server_watch *new_watches = realloc(watches,
+			MAX(count, 1) * sizeof(struct server_watch));
+	if (new_watches == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	watches = new_watches;
+	watch_count = 0;
+
+	if (epoll_fd != -1)
+		close(epoll_fd);
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1) {
+		LOG_ERROR("error creating epoll instance: %s", strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	for (struct service *service = services; service; service = service->next) {
+		struct server_watch *watch = &watches[watch_count];
+		watch->service = service;
+		watch->connection = NULL;
+		int fd = service->fd;
+		struct connection *c = service->connections;
+		for (;;) {
+			if (fd >= 0) {
+				struct epoll_event event = {
+					.events = EPOLLIN,
+					.data.u32 = watch_count,
+				};
+				if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+					LOG_ERROR("error watching '%s' file descriptor %d: %s",
+						service->name, fd, strerror(errno));
+					return ERROR_FAIL;
+				}
+				watch_count++;
+			}
+			if (!c)
+				break;
+			watch = &watches[watch_count];
+			watch->service = service;
+			watch->connection = c;
+			fd = c->fd;
+			c = c->next;
+		}
+	}
+
+	watched_fds_changed = false;
+	return ERROR_OK;
+}
+
+/* server_loop() on epoll: only the descriptors with input are looked at,
+ * and the loop sleeps until the next timer callback is due. */
+static int server_loop_epoll(struct command_context *command_context)
+{
+	bool poll_ok = true;
+
+	while (shutdown_openocd == CONTINUE_MAIN_LOOP) {
+		/* Some descriptors, such as regular files, can't be watched.
+		 * Let server_loop() carry on with select() then. */
+		if (watched_fds_changed && server_watch_fds() != ERROR_OK)
+			return ERROR_OK;
+
+		/* Buffered input is handled without waiting */
+		bool input_pending = false;
+		for (struct service *service = services; service; service = service->next)
+			for (struct connection *c = service->connections; c; c = c->next)
+				input_pending = input_pending || c->input_pending;
+
+		struct epoll_event events[MAX_EPOLL_EVENTS];
+		int retval;
+		if (poll_ok || input_pending) {
+			retval = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, 0);
+		} else {
+			/* Only while we're sleeping we'll let others run */
+			openocd_sleep_prelude();
+			kept_alive();
+			retval = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS,
+					server_timeout_ms());
+			openocd_sleep_postlude();
+		}
+
+		if (retval == -1 && errno != EINTR) {
+			LOG_ERROR("error during epoll_wait: %s", strerror(errno));
+			return ERROR_FAIL;
+		}
+
+		if (retval == 0) {
+			/* We only execute these callbacks when there was nothing to do or we timed
+			 *out */
+			target_call_timer_callbacks();
+			process_jim_events(command_context);
+
+			/* We timed out/there was nothing to do, timeout rather than poll next time
+			 **/
+			poll_ok = false;
+		} else {
+			/* There was something to do, next time we'll just poll */
+			poll_ok = true;
+		}
+
+		/* This is a simple back-off algorithm where we immediately
+		 * re-poll if we did something this time around.
+		 *
+		 * This greatly improves performance of DCC.
+		 */
+		poll_ok = poll_ok || target_got_message();
+
+		/* Once services or connections have come or gone, the watches may
+		 * point to freed ones. epoll reports the remaining events again. */
+		for (int i = 0; i < retval && !watched_fds_changed; i++) {
+			struct server_watch *watch = &watches[events[i].data.u32];
+			if (watch->connection)
+				connection_input(watch->service, watch->connection);
+			else
+				service_accept(watch->service, command_context);
+		}
+
+		for (struct service *service = services;
+				service && input_pending && !watched_fds_changed;
+				service = service->next) {
+			for (struct connection *c = service->connections;
+					c && !watched_fds_changed; c = c->next) {
+				if (c->input_pending)
+					connection_input(service, c);
+			}
+		}
+	}
+
+	return ERROR_OK;
+}
+
+#endif /* HAVE_SYS_EPOLL_H */
+
+/* server_loop() on select(), which needs the file descriptors of all the
+ * services and connections on every pass */
+static int server_loop_select(struct command_context *command_context)
 {
 	struct service *service;
 
@@ -434,14 +662,8 @@ int server_loop(struct command_context *command_context)
 	fd_set read_fds;
 	int fd_max;
 
-	/* used in accept() */
 	int retval;
 
-#ifndef _WIN32
-	if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
-		LOG_ERROR("couldn't set SIGPIPE to SIG_IGN");
-#endif
-
 	while (shutdown_openocd == CONTINUE_MAIN_LOOP) {
 		/* monitor sockets for activity */
 		fd_max = 0;
@@ -477,8 +699,9 @@ int server_loop(struct command_context *command_context)
 			tv.tv_usec = 0;
 			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
 		} else {
-			/* Every 100ms, can be changed with "poll_period" command */
-			tv.tv_usec = polling_period * 1000;
+			/* Every 100ms, can be changed with "poll_period" command,
+			 * or sooner if a timer callback is due */
+			tv.tv_usec = server_timeout_ms() * 1000;
 			/* Only while we're sleeping we'll let others run */
 			openocd_sleep_prelude();
 			kept_alive();
@@ -534,48 +757,18 @@ int server_loop(struct command_context *command_context)
 		for (service = services; service; service = service->next) {
 			/* handle new connections on listeners */
 			if ((service->fd != -1)
-				&& (FD_ISSET(service->fd, &read_fds))) {
-				if (service->max_connections != 0)
-					add_connection(service, command_context);
-				else {
-					if (service->type == CONNECTION_TCP) {
-						struct sockaddr_in sin;
-						socklen_t address_size = sizeof(sin);
-						int tmp_fd;
-						tmp_fd = accept(service->fd,
-								(struct sockaddr *)&service->sin,
-								&address_size);
-						close_socket(tmp_fd);
-					}
-					LOG_INFO(
-						"rejected '%s' connection, no more connections allowed",
-						service->name);
-				}
-			}
+				&& (FD_ISSET(service->fd, &read_fds)))
+				service_accept(service, command_context);
 
 			/* handle activity on connections */
 			if (service->connections) {
 				struct connection *c;
 
 				for (c = service->connections; c; ) {
-					if ((c->fd >= 0 && FD_ISSET(c->fd, &read_fds)) || c->input_pending) {
-						retval = service->input(c);
-						if (retval != ERROR_OK) {
-							struct connection *next = c->next;
-							if (service->type == CONNECTION_PIPE ||
-									service->type == CONNECTION_STDINOUT) {
-								/* if connection uses a pipe then
-								 * shutdown openocd on error */
-								shutdown_openocd = SHUTDOWN_REQUESTED;
-							}
-							remove_connection(service, c);
-							LOG_INFO("dropped '%s' connection",
-								service->name);
-							c = next;
-							continue;
-						}
-					}
-					c = c->next;
+					struct connection *next = c->next;
+					if ((c->fd >= 0 && FD_ISSET(c->fd, &read_fds)) || c->input_pending)
+						connection_input(service, c);
+					c = next;
 				}
 			}
 		}
@@ -589,6 +782,37 @@ int server_loop(struct command_context *command_context)
 #endif
 	}
 
+	return ERROR_OK;
+}
+
+int server_loop(struct command_context *command_context)
+{
+#ifndef _WIN32
+	if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
+		LOG_ERROR("couldn't set SIGPIPE to SIG_IGN");
+#endif
+
+	int retval = ERROR_OK;
+#ifdef HAVE_SYS_EPOLL_H
+	if (server_watch_fds() == ERROR_OK)
+		retval = server_loop_epoll(command_context);
+	if (epoll_fd != -1) {
+		close(epoll_fd);
+		epoll_fd = -1;
+	}
+	free(watches);
+	watches = NULL;
+	/* The epoll loop returns early when it can't watch the descriptors */
+	if (retval == ERROR_OK && shutdown_openocd == CONTINUE_MAIN_LOOP) {
+		LOG_WARNING("falling back to select()");
+		retval = server_loop_select(command_context);
+	}
+#else
+	retval = server_loop_select(command_context);
+#endif
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* when quit for signal or CTRL-C, run (eventually user implemented) "shutdown" */
 	if (shutdown_openocd == SHUTDOWN_WITH_SIGNAL_CODE)
 		command_run_line(command_context, "shutdown");
@@ -737,6 +961,33 @@ int connection_write(struct connection *connection, const void *data, int len)
 		return write(connection->fd_out, data, len);
 }
 
+#define CONNECTION_MAX_BUFS 8
+
+int connection_writev(struct connection *connection,
+		const struct connection_buf *bufs, int count)
+{
+#ifdef HAVE_SYS_UIO_H
+	if (count <= CONNECTION_MAX_BUFS) {
+		struct iovec iov[CONNECTION_MAX_BUFS];
+		for (int i = 0; i < count; i++) {
+			iov[i].iov_base = (void *)bufs[i].data;
+			iov[i].iov_len = bufs[i].len;
+		}
+		return writev(connection->fd_out, iov, count);
+	}
+#endif
+	int written = 0;
+	for (int i = 0; i < count; i++) {
+		int retval = connection_write(connection, bufs[i].data, bufs[i].len);
+		if (retval < 0)
+			return retval;
+		written += retval;
+		if (retval != bufs[i].len)
+			break;
+	}
+	return written;
+}
+
 int connection_read(struct connection *connection, void *data, int len)
 {
 	if (connection->service->type == CONNECTION_TCP)
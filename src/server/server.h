@@ -95,6 +95,23 @@ int server_loop(struct command_context *command_context);
 int server_register_commands(struct command_context *context);
 
 int connection_write(struct connection *connection, const void *data, int len);
+
+/**
+ * A piece of data for connection_writev()
+ */
+struct connection_buf {
+	const void *data;
+	int len;
+};
+
+/**
+ * Write several pieces of data in one go, with a single system call where
+ * the host has writev().
+ *
+ * @returns the number of bytes written, or -1 on error.
+ */
+int connection_writev(struct connection *connection,
+		const struct connection_buf *bufs, int count);
 int connection_read(struct connection *connection, void *data, int len);
 
 /**
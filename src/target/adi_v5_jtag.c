@@ -140,8 +140,6 @@ struct dap_cmd {
 	uint8_t outvalue_buf[4];
 };
 
-#define MAX_DAP_COMMAND_NUM 65536
-
 struct dap_cmd_pool {
 	struct list_head lh;
 	struct dap_cmd cmd;
@@ -161,12 +159,58 @@ static void log_dap_cmd(const char *header, struct dap_cmd *el)
 #endif
 }
 
+/* Run the queue once it holds that many transactions */
+static size_t dap_cmd_queue_limit(struct adiv5_dap *dap)
+{
+	if (dap->cmd_queue_limit)
+		return dap->cmd_queue_limit;
+	return MAX_DAP_COMMAND_NUM;
+}
+
+/* Number of dap_cmd objects worth allocating up front: enough for the
+ * adapter queue or, when set, the queue limit. */
+static size_t dap_cmd_pool_wanted(struct adiv5_dap *dap)
+{
+	unsigned depth = jtag_get_queue_depth();
+	if (!depth)
+		return dap->cmd_queue_limit;
+	return MIN(depth, dap_cmd_queue_limit(dap));
+}
+
+/* Allocate the dap_cmd objects for a full queue up front, when its size is
+ * known. */
+static int dap_cmd_pool_reserve(struct adiv5_dap *dap)
+{
+	size_t limit = dap_cmd_pool_wanted(dap);
+	dap->cmd_pool_reserved = limit;
+
+	size_t count = dap->cmd_pool_size;
+	struct dap_cmd_pool *pool;
+	list_for_each_entry(pool, &dap->cmd_pool, lh)
+		count++;
+
+	for (; count < limit; count++) {
+		pool = calloc(1, sizeof(struct dap_cmd_pool));
+		if (pool == NULL)
+			return ERROR_FAIL;
+		dap->cmd_allocations++;
+		list_add(&pool->lh, &dap->cmd_pool);
+	}
+	return ERROR_OK;
+}
+
 static int jtag_limit_queue_size(struct adiv5_dap *dap)
 {
-	if (dap->cmd_pool_size < MAX_DAP_COMMAND_NUM)
-		return ERROR_OK;
+	if (dap->cmd_pool_size >= dap_cmd_queue_limit(dap))
+		return dap_run(dap);
+
+	/* "queue_limit" or the adapter queue depth changed. The adapter sends
+	 * the scans in batches of its own when the queue runs, so they are not
+	 * executed any earlier. */
+	if (dap->cmd_pool_reserved != dap_cmd_pool_wanted(dap))
+		return dap_cmd_pool_reserve(dap);
 
-	return dap_run(dap);
+	return ERROR_OK;
 }
 
 static struct dap_cmd *dap_cmd_new(struct adiv5_dap *dap, uint8_t instr,
@@ -181,6 +225,7 @@ static struct dap_cmd *dap_cmd_new(struct adiv5_dap *dap, uint8_t instr,
 		pool = calloc(1, sizeof(struct dap_cmd_pool));
 		if (pool == NULL)
 			return NULL;
+		dap->cmd_allocations++;
 	} else {
 		pool = list_first_entry(&dap->cmd_pool, struct dap_cmd_pool, lh);
 		list_del(&pool->lh);
@@ -188,6 +233,7 @@ static struct dap_cmd *dap_cmd_new(struct adiv5_dap *dap, uint8_t instr,
 
 	INIT_LIST_HEAD(&pool->lh);
 	dap->cmd_pool_size++;
+	dap->cmd_queued++;
 
 	struct dap_cmd *cmd = &pool->cmd;
 	INIT_LIST_HEAD(&cmd->lh);
@@ -660,6 +706,8 @@ static int jtagdp_transaction_endcheck(struct adiv5_dap *dap)
 static int jtag_connect(struct adiv5_dap *dap)
 {
 	dap->do_reconnect = false;
+	if (dap_cmd_pool_reserve(dap) != ERROR_OK)
+		return ERROR_FAIL;
 	return dap_dp_init(dap);
 }
 
@@ -792,6 +840,7 @@ static int jtag_dp_run(struct adiv5_dap *dap)
 	int retval;
 	int retval2 = ERROR_OK;
 
+	dap->cmd_queue_runs++;
 	retval = adi_jtag_finish_read(dap);
 	if (retval != ERROR_OK)
 		goto done;
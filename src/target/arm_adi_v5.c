@@ -181,6 +181,29 @@ static void mem_ap_update_tar_cache(struct adiv5_ap *ap)
 		ap->tar_value += inc;
 }
 
+/**
+ * Number of bytes moved by the next DRW transfer of a block access.
+ *
+ * Packed transfers are only used from a word aligned address. A run of them
+ * then never straddles a TAR autoincrement boundary, so the CSW changes at
+ * most twice per block access, going in and out of packed mode, and the TAR
+ * is only written at autoincrement boundaries.
+ *
+ * @param ap The MEM-AP.
+ * @param size Access size, in bytes.
+ * @param nbytes Number of bytes left to transfer.
+ * @param address Address of the next transfer.
+ * @param addrinc Whether the address is incremented after each transfer.
+ */
+static uint32_t mem_ap_transfer_size(struct adiv5_ap *ap, uint32_t size,
+		size_t nbytes, uint32_t address, bool addrinc)
+{
+	if (addrinc && ap->packed_transfers && size < 4 && nbytes >= 4
+			&& (address & 3) == 0)
+		return 4;
+	return size;
+}
+
 /**
  * Queue transactions setting up transfer parameters for the
  * currently selected MEM-AP.
@@ -365,16 +388,13 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
 	while (nbytes > 0) {
-		uint32_t this_size = size;
+		uint32_t this_size = mem_ap_transfer_size(ap, size, nbytes, address, addrinc);
 
 		/* Select packed transfer if possible */
-		if (addrinc && ap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
-			this_size = 4;
+		if (this_size != size)
 			retval = mem_ap_setup_csw(ap, csw_size | CSW_ADDRINC_PACKED);
-		} else {
+		else
 			retval = mem_ap_setup_csw(ap, csw_size | csw_addrincr);
-		}
 
 		if (retval != ERROR_OK)
 			break;
@@ -499,16 +519,13 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 	 * useful bytes it contains, and their location in the word, depends on the type of transfer
 	 * and alignment. */
 	while (nbytes > 0) {
-		uint32_t this_size = size;
+		uint32_t this_size = mem_ap_transfer_size(ap, size, nbytes, address, addrinc);
 
 		/* Select packed transfer if possible */
-		if (addrinc && ap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
-			this_size = 4;
+		if (this_size != size)
 			retval = mem_ap_setup_csw(ap, csw_size | CSW_ADDRINC_PACKED);
-		} else {
+		else
 			retval = mem_ap_setup_csw(ap, csw_size | csw_addrincr);
-		}
 		if (retval != ERROR_OK)
 			break;
 
@@ -552,12 +569,7 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 
 	/* Replay loop to populate caller's buffer from the correct word and byte lane */
 	while (nbytes > 0) {
-		uint32_t this_size = size;
-
-		if (addrinc && ap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
-			this_size = 4;
-		}
+		uint32_t this_size = mem_ap_transfer_size(ap, size, nbytes, address, addrinc);
 
 		if (dap->ti_be_32_quirks) {
 			switch (this_size) {
@@ -654,6 +666,7 @@ int dap_dp_init(struct adiv5_dap *dap)
 
 	dap->do_reconnect = false;
 	dap_invalidate_cache(dap);
+	dap_invalidate_cs_components(dap);
 
 	/*
 	 * Early initialize dap->dp_ctrl_stat.
@@ -936,32 +949,165 @@ int dap_get_debugbase(struct adiv5_ap *ap,
 	return ERROR_OK;
 }
 
+/*
+ * CoreSight component identification, cached per AP so that walking the ROM
+ * tables again, for instance once for every core, takes no round trip.
+ */
+struct adiv5_cs_component {
+	struct adiv5_cs_component *next;
+	uint32_t base;
+	uint32_t cid;
+	uint64_t pid;
+	/* DEVTYPE, or MEMTYPE for a ROM table */
+	uint32_t devtype;
+	/* ROM table entries up to the first 0 or the reserved area, once read */
+	uint32_t *rom_entries;
+	unsigned int rom_entry_count;
+};
+
+/* DEVTYPE/MEMTYPE up to CIDR3, read in one burst */
+#define CS_ID_BLOCK_OFFSET	0xFCC
+#define CS_ID_BLOCK_WORDS	((0x1000 - CS_ID_BLOCK_OFFSET) / 4)
+#define CS_ROM_TABLE_END	0xF00
+#define CS_ROM_TABLE_BURST	32
+
+static void dap_invalidate_ap_cs_components(struct adiv5_ap *ap)
+{
+	struct adiv5_cs_component *c = ap->cs_components;
+	while (c) {
+		struct adiv5_cs_component *next = c->next;
+		free(c->rom_entries);
+		free(c);
+		c = next;
+	}
+	ap->cs_components = NULL;
+}
+
+void dap_invalidate_cs_components(struct adiv5_dap *dap)
+{
+	for (int i = 0; i <= DP_APSEL_MAX; i++)
+		dap_invalidate_ap_cs_components(&dap->ap[i]);
+}
+
+static int dap_get_cs_component(struct adiv5_ap *ap, uint32_t component_base,
+		struct adiv5_cs_component **component)
+{
+	assert((component_base & 0xFFF) == 0);
+
+	struct adiv5_cs_component *c;
+	for (c = ap->cs_components; c; c = c->next) {
+		if (c->base == component_base)
+			break;
+	}
+
+	/* A component read while its power domain was down reads as zeros,
+	 * so only trust the cached IDs if the CID preamble is valid. */
+	if (c && is_dap_cid_ok(c->cid)) {
+		*component = c;
+		return ERROR_OK;
+	}
+
+	/* IDs are in last 4K section */
+	uint8_t buf[CS_ID_BLOCK_WORDS * 4];
+	int retval = mem_ap_read_buf(ap, buf, 4, CS_ID_BLOCK_WORDS,
+			component_base | CS_ID_BLOCK_OFFSET);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (c == NULL) {
+		c = calloc(1, sizeof(*c));
+		if (c == NULL)
+			return ERROR_FAIL;
+		c->next = ap->cs_components;
+		ap->cs_components = c;
+	} else {
+		free(c->rom_entries);
+		c->rom_entries = NULL;
+		c->rom_entry_count = 0;
+	}
+
+#define CS_ID_REG(offset) (buf_get_u32(buf + (offset) - CS_ID_BLOCK_OFFSET, 0, 32) & 0xff)
+	c->base = component_base;
+	c->devtype = buf_get_u32(buf, 0, 32);
+	c->cid = CS_ID_REG(0xFFC) << 24
+			| CS_ID_REG(0xFF8) << 16
+			| CS_ID_REG(0xFF4) << 8
+			| CS_ID_REG(0xFF0);
+	c->pid = (uint64_t)CS_ID_REG(0xFD0) << 32
+			| CS_ID_REG(0xFEC) << 24
+			| CS_ID_REG(0xFE8) << 16
+			| CS_ID_REG(0xFE4) << 8
+			| CS_ID_REG(0xFE0);
+#undef CS_ID_REG
+
+	*component = c;
+	return ERROR_OK;
+}
+
+static int dap_get_rom_entries(struct adiv5_ap *ap, struct adiv5_cs_component *rom)
+{
+	if (rom->rom_entries)
+		return ERROR_OK;
+
+	uint32_t *entries = NULL;
+	unsigned int count = 0;
+	bool end = false;
+	for (uint32_t offset = 0; !end && offset < CS_ROM_TABLE_END;
+			offset += CS_ROM_TABLE_BURST * 4) {
+		unsigned int words = MIN(CS_ROM_TABLE_BURST, (CS_ROM_TABLE_END - offset) / 4);
+		uint8_t buf[CS_ROM_TABLE_BURST * 4];
+		int retval = mem_ap_read_buf(ap, buf, 4, words, rom->base | offset);
+		if (retval != ERROR_OK) {
+			free(entries);
+			return retval;
+		}
+
+		uint32_t *new_entries = realloc(entries, (count + words) * sizeof(uint32_t));
+		if (new_entries == NULL) {
+			free(entries);
+			return ERROR_FAIL;
+		}
+		entries = new_entries;
+
+		for (unsigned int i = 0; !end && i < words; i++) {
+			entries[count] = buf_get_u32(buf + 4 * i, 0, 32);
+			end = entries[count++] == 0;
+		}
+	}
+
+	rom->rom_entries = entries;
+	rom->rom_entry_count = count;
+	return ERROR_OK;
+}
+
 int dap_lookup_cs_component(struct adiv5_ap *ap,
 			uint32_t dbgbase, uint8_t type, uint32_t *addr, int32_t *idx)
 {
-	uint32_t romentry, entry_offset = 0, component_base, devtype;
+	struct adiv5_cs_component *rom;
 	int retval;
 
 	*addr = 0;
 
-	do {
-		retval = mem_ap_read_atomic_u32(ap, (dbgbase&0xFFFFF000) |
-						entry_offset, &romentry);
-		if (retval != ERROR_OK)
-			return retval;
+	retval = dap_get_cs_component(ap, dbgbase & 0xFFFFF000, &rom);
+	if (retval != ERROR_OK)
+		return retval;
+	retval = dap_get_rom_entries(ap, rom);
+	if (retval != ERROR_OK)
+		return retval;
 
-		component_base = (dbgbase & 0xFFFFF000)
-			+ (romentry & 0xFFFFF000);
+	for (unsigned int i = 0; i < rom->rom_entry_count; i++) {
+		uint32_t romentry = rom->rom_entries[i];
+		uint32_t component_base = rom->base + (romentry & 0xFFFFF000);
 
 		if (romentry & 0x1) {
-			uint32_t c_cid1;
-			retval = mem_ap_read_atomic_u32(ap, component_base | 0xff4, &c_cid1);
+			struct adiv5_cs_component *c;
+			retval = dap_get_cs_component(ap, component_base, &c);
 			if (retval != ERROR_OK) {
 				LOG_ERROR("Can't read component with base address 0x%" PRIx32
 					  ", the corresponding core might be turned off", component_base);
 				return retval;
 			}
-			if (((c_cid1 >> 4) & 0x0f) == 1) {
+			if (((c->cid >> 12) & 0x0f) == 1) {
 				retval = dap_lookup_cs_component(ap, component_base,
 							type, addr, idx);
 				if (retval == ERROR_OK)
@@ -970,12 +1116,7 @@ int dap_lookup_cs_component(struct adiv5_ap *ap,
 					return retval;
 			}
 
-			retval = mem_ap_read_atomic_u32(ap,
-					(component_base & 0xfffff000) | 0xfcc,
-					&devtype);
-			if (retval != ERROR_OK)
-				return retval;
-			if ((devtype & 0xff) == type) {
+			if ((c->devtype & 0xff) == type) {
 				if (!*idx) {
 					*addr = component_base;
 					break;
@@ -983,8 +1124,7 @@ int dap_lookup_cs_component(struct adiv5_ap *ap,
 					(*idx)--;
 			}
 		}
-		entry_offset += 4;
-	} while (romentry > 0);
+	}
 
 	if (!*addr)
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
@@ -992,61 +1132,6 @@ int dap_lookup_cs_component(struct adiv5_ap *ap,
 	return ERROR_OK;
 }
 
-static int dap_read_part_id(struct adiv5_ap *ap, uint32_t component_base, uint32_t *cid, uint64_t *pid)
-{
-	assert((component_base & 0xFFF) == 0);
-	assert(ap != NULL && cid != NULL && pid != NULL);
-
-	uint32_t cid0, cid1, cid2, cid3;
-	uint32_t pid0, pid1, pid2, pid3, pid4;
-	int retval;
-
-	/* IDs are in last 4K section */
-	retval = mem_ap_read_u32(ap, component_base + 0xFE0, &pid0);
-	if (retval != ERROR_OK)
-		return retval;
-	retval = mem_ap_read_u32(ap, component_base + 0xFE4, &pid1);
-	if (retval != ERROR_OK)
-		return retval;
-	retval = mem_ap_read_u32(ap, component_base + 0xFE8, &pid2);
-	if (retval != ERROR_OK)
-		return retval;
-	retval = mem_ap_read_u32(ap, component_base + 0xFEC, &pid3);
-	if (retval != ERROR_OK)
-		return retval;
-	retval = mem_ap_read_u32(ap, component_base + 0xFD0, &pid4);
-	if (retval != ERROR_OK)
-		return retval;
-	retval = mem_ap_read_u32(ap, component_base + 0xFF0, &cid0);
-	if (retval != ERROR_OK)
-		return retval;
-	retval = mem_ap_read_u32(ap, component_base + 0xFF4, &cid1);
-	if (retval != ERROR_OK)
-		return retval;
-	retval = mem_ap_read_u32(ap, component_base + 0xFF8, &cid2);
-	if (retval != ERROR_OK)
-		return retval;
-	retval = mem_ap_read_u32(ap, component_base + 0xFFC, &cid3);
-	if (retval != ERROR_OK)
-		return retval;
-
-	retval = dap_run(ap->dap);
-	if (retval != ERROR_OK)
-		return retval;
-
-	*cid = (cid3 & 0xff) << 24
-			| (cid2 & 0xff) << 16
-			| (cid1 & 0xff) << 8
-			| (cid0 & 0xff);
-	*pid = (uint64_t)(pid4 & 0xff) << 32
-			| (pid3 & 0xff) << 24
-			| (pid2 & 0xff) << 16
-			| (pid1 & 0xff) << 8
-			| (pid0 & 0xff);
-
-	return ERROR_OK;
-}
-
 /* The designer identity code is encoded as:
  * bits 11:8 : JEP106 Bank (number of continuation codes), only valid when bit 7 is 1.
  * bit 7     : Set when bits 6:0 represent a JEP106 ID and cleared when bits 6:0 represent
@@ -1197,11 +1282,14 @@ static int dap_rom_display(struct command_invocation *cmd,
 	uint32_t base_addr = dbgbase & 0xFFFFF000;
 	command_print(cmd, "\t\tComponent base address 0x%08" PRIx32, base_addr);
 
-	retval = dap_read_part_id(ap, base_addr, &cid, &pid);
+	struct adiv5_cs_component *component;
+	retval = dap_get_cs_component(ap, base_addr, &component);
 	if (retval != ERROR_OK) {
 		command_print(cmd, "\t\tCan't read component, the corresponding core might be turned off");
 		return ERROR_OK; /* Don't abort recursion */
 	}
+	cid = component->cid;
+	pid = component->pid;
 
 	if (!is_dap_cid_ok(cid)) {
 		command_print(cmd, "\t\tInvalid CID 0x%08" PRIx32, cid);
@@ -1252,22 +1340,19 @@ static int dap_rom_display(struct command_invocation *cmd,
 	command_print(cmd, "\t\tComponent class is 0x%" PRIx8 ", %s", class, class_description[class]);
 
 	if (class == 1) { /* ROM Table */
-		uint32_t memtype;
-		retval = mem_ap_read_atomic_u32(ap, base_addr | 0xFCC, &memtype);
-		if (retval != ERROR_OK)
-			return retval;
-
+		uint32_t memtype = component->devtype;
 		if (memtype & 0x01)
 			command_print(cmd, "\t\tMEMTYPE system memory present on bus");
 		else
 			command_print(cmd, "\t\tMEMTYPE system memory not present: dedicated debug bus");
 
 		/* Read ROM table entries from base address until we get 0x00000000 or reach the reserved area */
-		for (uint16_t entry_offset = 0; entry_offset < 0xF00; entry_offset += 4) {
-			uint32_t romentry;
-			retval = mem_ap_read_atomic_u32(ap, base_addr | entry_offset, &romentry);
-			if (retval != ERROR_OK)
-				return retval;
+		retval = dap_get_rom_entries(ap, component);
+		if (retval != ERROR_OK)
+			return retval;
+		for (unsigned int i = 0; i < component->rom_entry_count; i++) {
+			uint32_t romentry = component->rom_entries[i];
+			unsigned int entry_offset = 4 * i;
 			command_print(cmd, "\t%sROMTABLE[0x%x] = 0x%" PRIx32 "",
 					tabs, entry_offset, romentry);
 			if (romentry & 0x01) {
@@ -1285,10 +1370,7 @@ static int dap_rom_display(struct command_invocation *cmd,
 	} else if (class == 9) { /* CoreSight component */
 		const char *major = "Reserved", *subtype = "Reserved";
 
-		uint32_t devtype;
-		retval = mem_ap_read_atomic_u32(ap, base_addr | 0xFCC, &devtype);
-		if (retval != ERROR_OK)
-			return retval;
+		uint32_t devtype = component->devtype;
 		unsigned minor = (devtype >> 4) & 0x0f;
 		switch (devtype & 0x0f) {
 		case 0:
@@ -1439,6 +1521,9 @@ int dap_info_command(struct command_invocation *cmd,
 	uint32_t dbgbase, apid;
 	uint8_t mem_ap;
 
+	/* Components may have been powered up or down since they were cached */
+	dap_invalidate_ap_cs_components(ap);
+
 	/* Now we read ROM table ID registers, ref. ARM IHI 0029B sec  */
 	retval = dap_get_debugbase(ap, &dbgbase, &apid);
 	if (retval != ERROR_OK)
@@ -1749,6 +1834,56 @@ COMMAND_HANDLER(dap_memaccess_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(dap_queue_limit_command)
+{
+	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+	unsigned limit;
+
+	switch (CMD_ARGC) {
+	case 0:
+		break;
+	case 1:
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], limit);
+		dap->cmd_queue_limit = limit;
+		break;
+	default:
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	command_print(CMD, "command queue limit set to %zu transactions",
+			dap->cmd_queue_limit ? dap->cmd_queue_limit : MAX_DAP_COMMAND_NUM);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(dap_queue_stats_command)
+{
+	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		dap->cmd_queued = 0;
+		dap->cmd_allocations = 0;
+		dap->cmd_queue_runs = 0;
+		dap->cmd_stats_start_ms = timeval_ms();
+		return ERROR_OK;
+	}
+
+	int64_t elapsed_ms = timeval_ms() - dap->cmd_stats_start_ms;
+	command_print(CMD, "commands queued:     %llu", dap->cmd_queued);
+	command_print(CMD, "command allocations: %llu", dap->cmd_allocations);
+	command_print(CMD, "queue runs:          %llu", dap->cmd_queue_runs);
+	if (elapsed_ms > 0)
+		command_print(CMD, "commands/s:          %llu",
+				dap->cmd_queued * 1000 / elapsed_ms);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(dap_apsel_command)
 {
 	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
@@ -2012,6 +2147,21 @@ const struct command_registration dap_instance_commands[] = {
 			"bus access [0-255]",
 		.usage = "[cycles]",
 	},
+	{
+		.name = "queue_limit",
+		.handler = dap_queue_limit_command,
+		.mode = COMMAND_ANY,
+		.help = "set/get number of queued JTAG-DP transactions that makes "
+			"the queue run, 0 for the default of 65536",
+		.usage = "[count]",
+	},
+	{
+		.name = "queue_stats",
+		.handler = dap_queue_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show or reset JTAG-DP transaction queue statistics",
+		.usage = "['reset']",
+	},
 	{
 		.name = "ti_be_32_quirks",
 		.handler = dap_ti_be_32_quirks_command,
@@ -220,8 +220,13 @@ struct adiv5_ap {
 
 	/* true if tar_value is in sync with TAR register */
 	bool tar_valid;
+
+	/* CoreSight components identified on this MEM-AP */
+	struct adiv5_cs_component *cs_components;
 };
 
+/* Default number of queued JTAG-DP transactions that makes the queue run */
+#define MAX_DAP_COMMAND_NUM 65536
 
 /**
  * This represents an ARM Debug Interface (v5) Debug Access Port (DAP).
@@ -251,6 +256,19 @@ struct adiv5_dap {
 	/* number of dap_cmd objects in the pool */
 	size_t cmd_pool_size;
 
+	/* Number of queued transactions that makes the queue run, 0 for
+	 * MAX_DAP_COMMAND_NUM. */
+	size_t cmd_queue_limit;
+
+	/* number of dap_cmd objects allocated up front */
+	size_t cmd_pool_reserved;
+
+	/* Command queue statistics, since cmd_stats_start_ms */
+	unsigned long long cmd_queued;
+	unsigned long long cmd_allocations;
+	unsigned long long cmd_queue_runs;
+	int64_t cmd_stats_start_ms;
+
 	struct jtag_tap *tap;
 	/* Control config */
 	uint32_t dp_ctrl_stat;
@@ -572,6 +590,9 @@ static inline struct adiv5_ap *dap_ap(struct adiv5_dap *dap, uint8_t ap_num)
 	return &dap->ap[ap_num];
 }
 
+/* Forget the CoreSight components identified on the APs of a DAP */
+void dap_invalidate_cs_components(struct adiv5_dap *dap);
+
 /* Lookup CoreSight component */
 int dap_lookup_cs_component(struct adiv5_ap *ap,
 			uint32_t dbgbase, uint8_t type, uint32_t *addr, int32_t *idx);
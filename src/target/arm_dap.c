@@ -27,6 +27,7 @@
 #include "target/arm.h"
 #include "helper/list.h"
 #include "helper/command.h"
+#include "helper/time_support.h"
 #include "transport/transport.h"
 #include "jtag/interface.h"
 
@@ -60,6 +61,7 @@ static void dap_instance_init(struct adiv5_dap *dap)
 	}
 	INIT_LIST_HEAD(&dap->cmd_journal);
 	INIT_LIST_HEAD(&dap->cmd_pool);
+	dap->cmd_stats_start_ms = timeval_ms();
 }
 
 const char *adiv5_dap_name(struct adiv5_dap *self)
@@ -143,6 +145,7 @@ int dap_cleanup_all(void)
 		dap = &obj->dap;
 		if (dap->ops && dap->ops->quit)
 			dap->ops->quit(dap);
+		dap_invalidate_cs_components(dap);
 
 		free(obj->name);
 		free(obj);
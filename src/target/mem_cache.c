@@ -0,0 +1,437 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/command.h>
+#include <helper/log.h>
+
+#include "target.h"
+#include "target_type.h"
+#include "smp.h"
+#include "mem_cache.h"
+
+/* A range of memory never cached, such as peripherals */
+struct mem_cache_region {
+	target_addr_t address;
+	target_addr_t size;
+	struct mem_cache_region *next;
+};
+
+struct mem_cache_line {
+	bool valid;
+	target_addr_t address;
+	uint8_t *data;
+};
+
+/* Direct mapped: the line an address goes in only depends on the address */
+struct target_mem_cache {
+	bool enabled;
+	uint32_t line_size;
+	unsigned int num_lines;
+	struct mem_cache_line *lines;
+	uint8_t *data;
+	/* number of valid lines, to make invalidating an empty cache cheap */
+	unsigned int valid_lines;
+
+	struct mem_cache_region *uncacheable;
+
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t bypassed;
+	uint64_t invalidations;
+};
+
+static struct target_mem_cache *mem_cache_get(struct target *target)
+{
+	if (!target->mem_cache)
+		target->mem_cache = calloc(1, sizeof(struct target_mem_cache));
+	return target->mem_cache;
+}
+
+static void mem_cache_free_lines(struct target_mem_cache *cache)
+{
+	free(cache->lines);
+	free(cache->data);
+	cache->lines = NULL;
+	cache->data = NULL;
+	cache->num_lines = 0;
+	cache->valid_lines = 0;
+}
+
+static int mem_cache_alloc_lines(struct target_mem_cache *cache,
+		uint32_t line_size, unsigned int num_lines)
+{
+	mem_cache_free_lines(cache);
+
+	cache->lines = calloc(num_lines, sizeof(struct mem_cache_line));
+	cache->data = malloc((size_t)num_lines * line_size);
+	if (!cache->lines || !cache->data) {
+		LOG_ERROR("Unable to allocate a %u lines memory cache", num_lines);
+		mem_cache_free_lines(cache);
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < num_lines; i++)
+		cache->lines[i].data = cache->data + (size_t)i * line_size;
+	cache->line_size = line_size;
+	cache->num_lines = num_lines;
+	return ERROR_OK;
+}
+
+/* Whether none of [first, last] is in an uncacheable region */
+static bool mem_cache_cacheable(struct target_mem_cache *cache,
+		target_addr_t first, target_addr_t last)
+{
+	for (struct mem_cache_region *r = cache->uncacheable; r; r = r->next) {
+		if (first <= r->address + (r->size - 1) && r->address <= last)
+			return false;
+	}
+	return true;
+}
+
+static struct mem_cache_line *mem_cache_line(struct target_mem_cache *cache,
+		target_addr_t line_address)
+{
+	return &cache->lines[(line_address / cache->line_size) % cache->num_lines];
+}
+
+int target_mem_cache_read(struct target *target,
+		target_addr_t address, uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+	uint32_t len = size * count;
+
+	if (!cache || !cache->enabled || !len)
+		return target->type->read_memory(target, address, size, count, buffer);
+
+	/* A running target changes its memory under our feet */
+	if (target->state != TARGET_HALTED) {
+		target_mem_cache_invalidate(target);
+		cache->bypassed++;
+		return target->type->read_memory(target, address, size, count, buffer);
+	}
+
+	target_addr_t line_mask = ~(target_addr_t)(cache->line_size - 1);
+	if (!mem_cache_cacheable(cache, address & line_mask,
+				((address + len - 1) & line_mask) + cache->line_size - 1)) {
+		cache->bypassed++;
+		return target->type->read_memory(target, address, size, count, buffer);
+	}
+
+	target_addr_t next = address;
+	uint8_t *out = buffer;
+	uint32_t left = len;
+	while (left) {
+		target_addr_t line_address = next & line_mask;
+		struct mem_cache_line *line = mem_cache_line(cache, line_address);
+		uint32_t offset = next - line_address;
+		uint32_t chunk = MIN(left, cache->line_size - offset);
+
+		if (line->valid && line->address == line_address) {
+			cache->hits++;
+		} else {
+			cache->misses++;
+			if (!line->valid)
+				cache->valid_lines++;
+			line->valid = false;
+			int retval = target->type->read_memory(target, line_address, 4,
+					cache->line_size / 4, line->data);
+			if (retval != ERROR_OK) {
+				/* The whole line may not be readable, read exactly what
+				 * was asked for instead */
+				cache->valid_lines--;
+				cache->bypassed++;
+				return target->type->read_memory(target, address, size, count, buffer);
+			}
+			line->valid = true;
+			line->address = line_address;
+		}
+
+		memcpy(out, line->data + offset, chunk);
+		out += chunk;
+		next += chunk;
+		left -= chunk;
+	}
+
+	return ERROR_OK;
+}
+
+static void mem_cache_write_lines(struct target_mem_cache *cache,
+		target_addr_t address, uint32_t len, const uint8_t *buffer)
+{
+	if (!cache || !cache->valid_lines)
+		return;
+
+	target_addr_t line_mask = ~(target_addr_t)(cache->line_size - 1);
+	target_addr_t next = address;
+	const uint8_t *in = buffer;
+	uint32_t left = len;
+	while (left) {
+		target_addr_t line_address = next & line_mask;
+		struct mem_cache_line *line = mem_cache_line(cache, line_address);
+		uint32_t offset = next - line_address;
+		uint32_t chunk = MIN(left, cache->line_size - offset);
+
+		if (line->valid && line->address == line_address)
+			memcpy(line->data + offset, in, chunk);
+
+		in += chunk;
+		next += chunk;
+		left -= chunk;
+	}
+}
+
+static void mem_cache_drop_lines(struct target_mem_cache *cache)
+{
+	if (!cache || !cache->valid_lines)
+		return;
+
+	for (unsigned int i = 0; i < cache->num_lines; i++)
+		cache->lines[i].valid = false;
+	cache->valid_lines = 0;
+	cache->invalidations++;
+}
+
+/* The cores of an SMP group share their memory, so the caches of all of
+ * them are kept in step. The group list includes the target itself. */
+void target_mem_cache_write(struct target *target,
+		target_addr_t address, uint32_t size, uint32_t count, const uint8_t *buffer)
+{
+	if (!target->smp) {
+		mem_cache_write_lines(target->mem_cache, address, size * count, buffer);
+		return;
+	}
+
+	struct target_list *head;
+	foreach_smp_target(head, target->head)
+		mem_cache_write_lines(head->target->mem_cache, address, size * count, buffer);
+}
+
+void target_mem_cache_invalidate(struct target *target)
+{
+	if (!target->smp) {
+		mem_cache_drop_lines(target->mem_cache);
+		return;
+	}
+
+	struct target_list *head;
+	foreach_smp_target(head, target->head)
+		mem_cache_drop_lines(head->target->mem_cache);
+}
+
+void target_mem_cache_free(struct target *target)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+
+	if (!cache)
+		return;
+
+	mem_cache_free_lines(cache);
+	while (cache->uncacheable) {
+		struct mem_cache_region *next = cache->uncacheable->next;
+		free(cache->uncacheable);
+		cache->uncacheable = next;
+	}
+	free(cache);
+	target->mem_cache = NULL;
+}
+
+COMMAND_HANDLER(handle_mem_cache_enable_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	uint32_t line_size = MEM_CACHE_DEFAULT_LINE_SIZE;
+	unsigned int num_lines = MEM_CACHE_DEFAULT_LINES;
+
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC > 0)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], line_size);
+	if (CMD_ARGC > 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], num_lines);
+
+	if (line_size < 16 || line_size > 4096 || (line_size & (line_size - 1))) {
+		command_print(CMD, "line size must be a power of 2 from 16 to 4096 bytes");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	if (!num_lines) {
+		command_print(CMD, "the cache needs at least one line");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct target_mem_cache *cache = mem_cache_get(target);
+	if (!cache)
+		return ERROR_FAIL;
+
+	int retval = mem_cache_alloc_lines(cache, line_size, num_lines);
+	if (retval != ERROR_OK)
+		return retval;
+	cache->enabled = true;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_mem_cache_disable_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target_mem_cache *cache = target->mem_cache;
+	if (cache) {
+		cache->enabled = false;
+		mem_cache_free_lines(cache);
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_mem_cache_invalidate_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_mem_cache_invalidate(target);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_mem_cache_uncacheable_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 0 && CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target_mem_cache *cache = mem_cache_get(target);
+	if (!cache)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC == 2) {
+		target_addr_t address, size;
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[1], size);
+		if (!size)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+
+		struct mem_cache_region *region = malloc(sizeof(*region));
+		if (!region) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		region->address = address;
+		region->size = size;
+		region->next = cache->uncacheable;
+		cache->uncacheable = region;
+
+		/* The region may already be in the cache */
+		target_mem_cache_invalidate(target);
+		return ERROR_OK;
+	}
+
+	for (struct mem_cache_region *r = cache->uncacheable; r; r = r->next)
+		command_print(CMD, TARGET_ADDR_FMT " " TARGET_ADDR_FMT, r->address, r->size);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_mem_cache_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target_mem_cache *cache = target->mem_cache;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		if (cache) {
+			cache->hits = 0;
+			cache->misses = 0;
+			cache->bypassed = 0;
+			cache->invalidations = 0;
+		}
+		return ERROR_OK;
+	}
+
+	if (!cache || !cache->enabled) {
+		command_print(CMD, "memory cache disabled");
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "%u lines of %" PRIu32 " bytes, %u valid",
+			cache->num_lines, cache->line_size, cache->valid_lines);
+	command_print(CMD, "line hits %" PRIu64 ", misses %" PRIu64
+			", bypassed reads %" PRIu64 ", invalidations %" PRIu64,
+			cache->hits, cache->misses, cache->bypassed, cache->invalidations);
+	return ERROR_OK;
+}
+
+static const struct command_registration mem_cache_subcommand_handlers[] = {
+	{
+		.name = "enable",
+		.handler = handle_mem_cache_enable_command,
+		.mode = COMMAND_ANY,
+		.help = "cache memory reads while the target is halted",
+		.usage = "[line_size [lines]]",
+	},
+	{
+		.name = "disable",
+		.handler = handle_mem_cache_disable_command,
+		.mode = COMMAND_ANY,
+		.help = "stop caching memory reads",
+		.usage = "",
+	},
+	{
+		.name = "invalidate",
+		.handler = handle_mem_cache_invalidate_command,
+		.mode = COMMAND_EXEC,
+		.help = "drop the cached memory",
+		.usage = "",
+	},
+	{
+		.name = "uncacheable",
+		.handler = handle_mem_cache_uncacheable_command,
+		.mode = COMMAND_ANY,
+		.help = "never cache a memory region, or list these regions",
+		.usage = "[address size]",
+	},
+	{
+		.name = "stats",
+		.handler = handle_mem_cache_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "display, or reset, the cache hit/miss statistics",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration mem_cache_command_handlers[] = {
+	{
+		.name = "mem_cache",
+		.mode = COMMAND_ANY,
+		.help = "target memory cache command group",
+		.usage = "",
+		.chain = mem_cache_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -0,0 +1,55 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef OPENOCD_TARGET_MEM_CACHE_H
+#define OPENOCD_TARGET_MEM_CACHE_H
+
+#include <helper/types.h>
+
+struct target;
+struct command_registration;
+
+/**
+ * @file
+ * Optional cache of target memory, kept while the target is halted.
+ *
+ * GDB, the RTOS helpers and Tcl scripts tend to read the same memory over
+ * and over while the target is halted. With the cache enabled,
+ * target_read_memory() fetches whole lines and serves later reads from
+ * them. Writes go through to the target and update the cached lines.
+ *
+ * The cache is invalidated whenever the target may have changed its memory
+ * behind our back: resume, step, reset, algorithm runs and flash writes.
+ * Memory that can change while halted, such as peripherals, is marked
+ * uncacheable. Writes and invalidations apply to all the cores of an SMP
+ * group, since they share their memory.
+ */
+
+#define MEM_CACHE_DEFAULT_LINE_SIZE 64
+#define MEM_CACHE_DEFAULT_LINES 256
+
+/** Read through the cache, if enabled and the target is halted */
+int target_mem_cache_read(struct target *target,
+		target_addr_t address, uint32_t size, uint32_t count, uint8_t *buffer);
+/** Update the cached lines after a successful write */
+void target_mem_cache_write(struct target *target,
+		target_addr_t address, uint32_t size, uint32_t count, const uint8_t *buffer);
+/** Drop all the cached lines */
+void target_mem_cache_invalidate(struct target *target);
+void target_mem_cache_free(struct target *target);
+
+extern const struct command_registration mem_cache_command_handlers[];
+
+#endif /* OPENOCD_TARGET_MEM_CACHE_H */
@@ -70,6 +70,14 @@ void riscv_batch_free(struct riscv_batch *batch)
 	free(batch);
 }
 
+void riscv_batch_reset(struct riscv_batch *batch, size_t idle)
+{
+	batch->used_scans = 0;
+	batch->read_keys_used = 0;
+	batch->idle_count = idle;
+	batch->last_scan = RISCV_SCAN_TYPE_INVALID;
+}
+
 bool riscv_batch_full(struct riscv_batch *batch)
 {
 	return batch->used_scans > (batch->allocated_scans - 4);
@@ -107,8 +115,10 @@ int riscv_batch_run(struct riscv_batch *batch)
 			buffer_shr((batch->fields + i)->in_value, DMI_SCAN_BUF_SIZE, 1);
 	}
 
-	for (size_t i = 0; i < batch->used_scans; ++i)
-		dump_field(batch->idle_count, batch->fields + i);
+	if (debug_level >= LOG_LVL_DEBUG) {
+		for (size_t i = 0; i < batch->used_scans; ++i)
+			dump_field(batch->idle_count, batch->fields + i);
+	}
 
 	return ERROR_OK;
 }
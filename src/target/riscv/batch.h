@@ -52,6 +52,10 @@ struct riscv_batch {
 struct riscv_batch *riscv_batch_alloc(struct target *target, size_t scans, size_t idle);
 void riscv_batch_free(struct riscv_batch *batch);
 
+/* Empties this batch so it can be reused without being reallocated, with
+ * "idle" JTAG idle cycles between every real scan. */
+void riscv_batch_reset(struct riscv_batch *batch, size_t idle);
+
 /* Checks to see if this batch is full. */
 bool riscv_batch_full(struct riscv_batch *batch);
 
@@ -40,6 +40,8 @@ static void riscv013_clear_abstract_error(struct target *target);
 /* Implementations of the functions in riscv_info_t. */
 static int riscv013_get_register(struct target *target,
 		riscv_reg_t *value, int hid, int rid);
+static int riscv013_get_registers(struct target *target, int hartid,
+		unsigned count, const int *regids, riscv_reg_t *values);
 static int riscv013_set_register(struct target *target, int hartid, int regid, uint64_t value);
 static int riscv013_select_current_hart(struct target *target);
 static int riscv013_halt_prep(struct target *target);
@@ -50,6 +52,8 @@ static int riscv013_on_halt(struct target *target);
 static int riscv013_on_step(struct target *target);
 static int riscv013_resume_prep(struct target *target);
 static bool riscv013_is_halted(struct target *target);
+static int riscv013_poll_halted(struct target *target, unsigned poll_id,
+		int hartid, bool *halted);
 static enum riscv_halt_reason riscv013_halt_reason(struct target *target);
 static int riscv013_write_debug_buffer(struct target *target, unsigned index,
 		riscv_insn_t d);
@@ -75,6 +79,11 @@ void write_memory_sba_simple(struct target *target, target_addr_t addr, uint32_t
 void read_memory_sba_simple(struct target *target, target_addr_t addr,
 		uint32_t *rd_buf, uint32_t read_size, uint32_t sbcs);
 static int	riscv013_test_compliance(struct target *target);
+static void calibrate_mem_access(struct target *target);
+static struct riscv_batch *get_batch(struct target *target, size_t idle);
+static int batch_run(const struct target *target, struct riscv_batch *batch);
+static int riscv013_print_mem_access_methods(struct target *target,
+		struct command_invocation *cmd);
 
 /**
  * Since almost everything can be accomplish by scanning the dbus register, all
@@ -123,6 +132,36 @@ typedef enum slot {
 #define CMDERR_HALT_RESUME		4
 #define CMDERR_OTHER			7
 
+/* Bounds on the number of memory words queued in one batch by the progbuf
+ * and system bus accesses. The depth doubles after every batch the target
+ * kept up with, and halves whenever it was busy, since every access queued
+ * after a busy response has to be repeated. */
+#define BATCH_MIN_DEPTH		8
+#define BATCH_INITIAL_DEPTH	32
+#define BATCH_MAX_DEPTH		256
+
+/* Ways to access memory, in the order they are preferred when calibration
+ * measures the same rate for several of them. */
+typedef enum {
+	MEM_ACCESS_PROGBUF,
+	MEM_ACCESS_SYSBUS,
+	MEM_ACCESS_ABSTRACT,
+	MEM_ACCESS_METHODS,
+	/* Not calibrated: choose from riscv_prefer_sba and what the target
+	 * supports. */
+	MEM_ACCESS_DEFAULT = MEM_ACCESS_METHODS
+} mem_access_method_t;
+
+static const char * const mem_access_method_name[] = {
+	"progbuf", "sysbus", "abstract", "default"
+};
+
+/* Number of memory access sizes: 1, 2, 4, 8 and 16 bytes. */
+#define MEM_ACCESS_SIZES	5
+
+/* Bytes of the work area read and written to measure each access method. */
+#define MEM_ACCESS_CALIBRATION_BYTES	256
+
 /*** Info about the core being debugged. ***/
 
 struct trigger {
@@ -154,6 +193,13 @@ typedef struct {
 	int current_hartid;
 	bool hasel_supported;
 
+	/* Halted state of every hart, one bit per hart as in haltsum0, read by
+	 * sample_halted_harts() for the poll identified by halted_poll_id.
+	 * halted_sampled is false if it couldn't be read that way. */
+	unsigned halted_poll_id;
+	bool halted_sampled;
+	uint32_t haltsum[RISCV_MAX_HARTS / 32];
+
 	/* The program buffer stores executable code. 0 is an illegal instruction,
 	 * so we use 0 to mean the cached value is invalid. */
 	uint32_t progbuf_cache[16];
@@ -221,6 +267,20 @@ typedef struct {
 
 	/* DM that provides access to this target. */
 	dm013_info_t *dm;
+
+	/* Batch reused by the memory accesses, and the number of memory words
+	 * currently queued at once by progbuf reads and system bus accesses. */
+	struct riscv_batch *batch;
+	unsigned int read_batch_depth;
+	unsigned int sba_batch_depth;
+
+	/* Memory access method used for each access size, as chosen by
+	 * calibrate_mem_access(), and the rates it measured in bytes/s. A rate
+	 * of 0 means the method is not supported or failed. */
+	mem_access_method_t mem_read_method[MEM_ACCESS_SIZES];
+	mem_access_method_t mem_write_method[MEM_ACCESS_SIZES];
+	uint32_t mem_read_rate[MEM_ACCESS_SIZES][MEM_ACCESS_METHODS];
+	uint32_t mem_write_rate[MEM_ACCESS_SIZES][MEM_ACCESS_METHODS];
 } riscv013_info_t;
 
 LIST_HEAD(dm_list);
@@ -1527,6 +1587,9 @@ static void deinit_target(struct target *target)
 {
 	LOG_DEBUG("riscv_deinit_target()");
 	riscv_info_t *info = (riscv_info_t *) target->arch_info;
+	riscv013_info_t *info013 = info->version_specific;
+	if (info013 && info013->batch)
+		riscv_batch_free(info013->batch);
 	free(info->version_specific);
 	/* TODO: free register arch_info */
 	info->version_specific = NULL;
@@ -1757,6 +1820,9 @@ static int examine(struct target *target)
 		LOG_DEBUG(" hart %d: XLEN=%d, misa=0x%" PRIx64, i, r->xlen[i],
 				r->misa[i]);
 
+		if (i == target->coreid)
+			calibrate_mem_access(target);
+
 		if (!halted)
 			riscv013_step_or_resume_current_hart(target, false, false);
 	}
@@ -1904,62 +1970,297 @@ static int cleanup_after_vector_access(struct target *target, uint64_t vtype,
 	return ERROR_OK;
 }
 
-static int riscv013_get_register_buf(struct target *target,
-		uint8_t *value, int regno)
+/* Wait for the abstract command started by the last batch to complete, and
+ * update cmderr. Returns ERROR_TIMEOUT_REACHED if the batch failed only
+ * because the debug module was busy, in which case it may be run again. */
+static int vector_batch_done(struct target *target, struct riscv_batch *batch,
+		size_t abstractcs_read)
 {
-	assert(regno >= GDB_REGNO_V0 && regno <= GDB_REGNO_V31);
-
-	riscv_reg_t s0;
-	if (register_read(target, &s0, GDB_REGNO_S0) != ERROR_OK)
-		return ERROR_FAIL;
-
-	uint64_t mstatus;
-	if (prep_for_register_access(target, &mstatus, regno) != ERROR_OK)
-		return ERROR_FAIL;
+	RISCV013_INFO(info);
+	uint32_t abstractcs;
+	bool dmi_busy = riscv_batch_get_dmi_read_op(batch, abstractcs_read) !=
+		DMI_STATUS_SUCCESS;
+	if (dmi_busy) {
+		if (dmi_read(target, &abstractcs, DM_ABSTRACTCS) != ERROR_OK)
+			return ERROR_FAIL;
+	} else {
+		abstractcs = riscv_batch_get_dmi_read_data(batch, abstractcs_read);
+	}
+	while (get_field(abstractcs, DM_ABSTRACTCS_BUSY))
+		if (dmi_read(target, &abstractcs, DM_ABSTRACTCS) != ERROR_OK)
+			return ERROR_FAIL;
+	info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+	if (info->cmderr != CMDERR_NONE) {
+		LOG_DEBUG("Vector transfer failed; abstractcs=0x%x", abstractcs);
+		if (info->cmderr == CMDERR_BUSY)
+			increase_ac_busy_delay(target);
+		riscv013_clear_abstract_error(target);
+		dmi_write(target, DM_ABSTRACTAUTO, 0);
+		return info->cmderr == CMDERR_BUSY ? ERROR_TIMEOUT_REACHED : ERROR_FAIL;
+	}
+	if (dmi_busy) {
+		/* Some data transfers were dropped. */
+		dmi_write(target, DM_ABSTRACTAUTO, 0);
+		return ERROR_TIMEOUT_REACHED;
+	}
+	return ERROR_OK;
+}
 
-	uint64_t vtype, vl;
-	unsigned debug_vl;
-	if (prep_for_vector_access(target, &vtype, &vl, &debug_vl) != ERROR_OK)
+/* Run the program of read_vector_register() until vnum is back where it
+ * started, going by the number of slides counted in s1. */
+static int unslide_vector_register(struct target *target,
+		struct riscv_program *program, unsigned debug_vl)
+{
+	uint64_t slides;
+	if (register_read_direct(target, &slides, GDB_REGNO_S1) != ERROR_OK)
 		return ERROR_FAIL;
+	LOG_DEBUG("%" PRIu64 " slides done", slides);
+	for (unsigned left = (debug_vl - slides % debug_vl) % debug_vl; left > 0; left--)
+		if (riscv_program_exec(program, target) != ERROR_OK)
+			return ERROR_FAIL;
+	return ERROR_OK;
+}
 
-	unsigned vnum = regno - GDB_REGNO_V0;
+/* Read vector register vnum element by element, with the program
+ * vmv.x.s s0, vnum; vslide1down.vx vnum, vnum, s0
+ * which rotates the register back to where it started after debug_vl
+ * elements. The first execution loads s0; after that an access register
+ * command copies s0 to data0 and runs the program again every time data0 is
+ * read, so the elements stream out in batches. The program then also counts
+ * the slides in s1, so that vnum can be put back where it started if a batch
+ * fails. */
+static int read_vector_register(struct target *target, unsigned vnum,
+		uint8_t *value, unsigned debug_vl)
+{
+	RISCV013_INFO(info);
 	unsigned xlen = riscv_xlen(target);
+	bool stream = debug_vl >= 3 && has_sufficient_progbuf(target, 4);
 
 	struct riscv_program program;
 	riscv_program_init(&program, target);
 	riscv_program_insert(&program, vmv_x_s(S0, vnum));
 	riscv_program_insert(&program, vslide1down_vx(vnum, vnum, S0, true));
+	if (stream)
+		riscv_program_insert(&program, addi(S1, S1, 1));
 
-	int result = ERROR_OK;
-	for (unsigned i = 0; i < debug_vl; i++) {
-		/* Executing the program might result in an exception if there is some
-		 * issue with the vector implementation/instructions we're using. If that
-		 * happens, attempt to restore as usual. We may have clobbered the
-		 * vector register we tried to read already.
-		 * For other failures, we just return error because things are probably
-		 * so messed up that attempting to restore isn't going to help. */
-		result = riscv_program_exec(&program, target);
-		if (result == ERROR_OK) {
+	int result;
+	if (!stream) {
+		for (unsigned i = 0; i < debug_vl; i++) {
+			/* Executing the program might result in an exception if there
+			 * is some issue with the vector implementation/instructions
+			 * we're using. If that happens, attempt to restore as usual. We
+			 * may have clobbered the vector register we tried to read
+			 * already. */
+			result = riscv_program_exec(&program, target);
+			if (result != ERROR_OK)
+				return result;
 			uint64_t v;
 			if (register_read_direct(target, &v, GDB_REGNO_S0) != ERROR_OK)
 				return ERROR_FAIL;
 			buf_set_u64(value, xlen * i, xlen, v);
-		} else {
-			break;
 		}
+		return ERROR_OK;
+	}
+
+	/* Elements 0 to debug_vl - 3 are read with autoexec, which runs the
+	 * program for the last time as element debug_vl - 3 is read. The last two
+	 * are then in data0 and s0. */
+	unsigned autoexec_reads = debug_vl - 2;
+	/* Leave room in the batch for the last two elements. */
+	unsigned depth = MIN(info->read_batch_depth, BATCH_MAX_DEPTH - 4);
+	time_t start = time(NULL);
+	unsigned i = 0;
+	while (i < debug_vl) {
+		if (i == 0) {
+			if (register_write_direct(target, GDB_REGNO_S1, 0) != ERROR_OK)
+				return ERROR_FAIL;
+			result = riscv_program_exec(&program, target);
+			if (result != ERROR_OK)
+				return result;
+		}
+
+		struct riscv_batch *batch = get_batch(target,
+				info->dmi_busy_delay + info->ac_busy_delay);
+		if (!batch)
+			return ERROR_FAIL;
+
+		if (i == 0) {
+			riscv_batch_add_dmi_write(batch, DM_COMMAND,
+					access_register_command(target, GDB_REGNO_S0, xlen,
+						AC_ACCESS_REGISTER_TRANSFER | AC_ACCESS_REGISTER_POSTEXEC));
+			riscv_batch_add_dmi_write(batch, DM_ABSTRACTAUTO,
+					1 << DM_ABSTRACTAUTO_AUTOEXECDATA_OFFSET);
+		}
+
+		size_t data0_read[BATCH_MAX_DEPTH], data1_read[BATCH_MAX_DEPTH];
+		unsigned first = i;
+		while (i < autoexec_reads && i - first < depth) {
+			if (xlen > 32)
+				data1_read[i - first] = riscv_batch_add_dmi_read(batch, DM_DATA1);
+			data0_read[i - first] = riscv_batch_add_dmi_read(batch, DM_DATA0);
+			i++;
+		}
+		if (i == autoexec_reads) {
+			riscv_batch_add_dmi_write(batch, DM_ABSTRACTAUTO, 0);
+			if (xlen > 32)
+				data1_read[i - first] = riscv_batch_add_dmi_read(batch, DM_DATA1);
+			data0_read[i - first] = riscv_batch_add_dmi_read(batch, DM_DATA0);
+			i++;
+			riscv_batch_add_dmi_write(batch, DM_COMMAND,
+					access_register_command(target, GDB_REGNO_S0, xlen,
+						AC_ACCESS_REGISTER_TRANSFER));
+			if (xlen > 32)
+				data1_read[i - first] = riscv_batch_add_dmi_read(batch, DM_DATA1);
+			data0_read[i - first] = riscv_batch_add_dmi_read(batch, DM_DATA0);
+			i++;
+		}
+		size_t abstractcs_read = riscv_batch_add_dmi_read(batch, DM_ABSTRACTCS);
+
+		if (batch_run(target, batch) != ERROR_OK) {
+			LOG_ERROR("Failed to read v%d; it may have been clobbered.", vnum);
+			return ERROR_FAIL;
+		}
+		result = vector_batch_done(target, batch, abstractcs_read);
+		if (result != ERROR_OK) {
+			if (unslide_vector_register(target, &program, debug_vl) != ERROR_OK) {
+				LOG_ERROR("Failed to read v%d; it may have been clobbered.", vnum);
+				return ERROR_FAIL;
+			}
+			if (result != ERROR_TIMEOUT_REACHED ||
+					time(NULL) - start > riscv_command_timeout_sec) {
+				LOG_ERROR("Failed to read v%d.", vnum);
+				return ERROR_FAIL;
+			}
+			/* vnum is back where it started, so read it again with the
+			 * longer delays. */
+			i = 0;
+			continue;
+		}
+
+		for (unsigned j = first; j < i; j++) {
+			uint64_t v = riscv_batch_get_dmi_read_data(batch, data0_read[j - first]);
+			if (xlen > 32)
+				v |= (uint64_t) riscv_batch_get_dmi_read_data(batch,
+						data1_read[j - first]) << 32;
+			buf_set_u64(value, xlen * j, xlen, v);
+		}
+	}
+
+	return ERROR_OK;
+}
+
+/* Write vector register vnum element by element, with the program
+ * vslide1down.vx vnum, vnum, s0
+ * executed by an access register command every time data0 is written. */
+static int write_vector_register(struct target *target, unsigned vnum,
+		const uint8_t *value, unsigned debug_vl)
+{
+	RISCV013_INFO(info);
+	unsigned xlen = riscv_xlen(target);
+
+	struct riscv_program program;
+	riscv_program_init(&program, target);
+	riscv_program_insert(&program, vslide1down_vx(vnum, vnum, S0, true));
+	if (riscv_program_ebreak(&program) != ERROR_OK)
+		return ERROR_FAIL;
+	if (riscv_program_write(&program) != ERROR_OK)
+		return ERROR_FAIL;
+
+	unsigned depth = MIN(info->read_batch_depth, BATCH_MAX_DEPTH - 4);
+	time_t start = time(NULL);
+	unsigned i = 0;
+	while (i < debug_vl) {
+		struct riscv_batch *batch = get_batch(target,
+				info->dmi_busy_delay + info->ac_busy_delay);
+		if (!batch)
+			return ERROR_FAIL;
+
+		unsigned first = i;
+		while (i < debug_vl && i - first < depth) {
+			uint64_t v = buf_get_u64(value, xlen * i, xlen);
+			if (xlen > 32)
+				riscv_batch_add_dmi_write(batch, DM_DATA1, v >> 32);
+			riscv_batch_add_dmi_write(batch, DM_DATA0, v);
+			if (i == 0) {
+				riscv_batch_add_dmi_write(batch, DM_COMMAND,
+						access_register_command(target, GDB_REGNO_S0, xlen,
+							AC_ACCESS_REGISTER_TRANSFER | AC_ACCESS_REGISTER_WRITE |
+							AC_ACCESS_REGISTER_POSTEXEC));
+				riscv_batch_add_dmi_write(batch, DM_ABSTRACTAUTO,
+						1 << DM_ABSTRACTAUTO_AUTOEXECDATA_OFFSET);
+			}
+			i++;
+		}
+		if (i == debug_vl)
+			riscv_batch_add_dmi_write(batch, DM_ABSTRACTAUTO, 0);
+		size_t abstractcs_read = riscv_batch_add_dmi_read(batch, DM_ABSTRACTCS);
+
+		if (batch_run(target, batch) != ERROR_OK) {
+			LOG_ERROR("Failed to write v%d.", vnum);
+			return ERROR_FAIL;
+		}
+		int result = vector_batch_done(target, batch, abstractcs_read);
+		if (result != ERROR_OK) {
+			if (result != ERROR_TIMEOUT_REACHED ||
+					time(NULL) - start > riscv_command_timeout_sec) {
+				LOG_ERROR("Failed to write v%d.", vnum);
+				return ERROR_FAIL;
+			}
+			/* Writing all the elements again overwrites whatever the slides
+			 * done so far left in vnum. */
+			i = 0;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+/* Read several vector registers, saving and restoring the registers used to
+ * access them only once. */
+static int riscv013_get_register_bufs(struct target *target, unsigned count,
+		const int *regids, uint8_t **values)
+{
+	riscv_reg_t s0, s1;
+	if (register_read(target, &s0, GDB_REGNO_S0) != ERROR_OK)
+		return ERROR_FAIL;
+	if (register_read(target, &s1, GDB_REGNO_S1) != ERROR_OK)
+		return ERROR_FAIL;
+
+	uint64_t mstatus;
+	if (prep_for_register_access(target, &mstatus, regids[0]) != ERROR_OK)
+		return ERROR_FAIL;
+
+	uint64_t vtype, vl;
+	unsigned debug_vl;
+	if (prep_for_vector_access(target, &vtype, &vl, &debug_vl) != ERROR_OK)
+		return ERROR_FAIL;
+
+	int result = ERROR_OK;
+	for (unsigned i = 0; i < count && result == ERROR_OK; i++) {
+		assert(regids[i] >= GDB_REGNO_V0 && regids[i] <= GDB_REGNO_V31);
+		result = read_vector_register(target, regids[i] - GDB_REGNO_V0,
+				values[i], debug_vl);
 	}
 
 	if (cleanup_after_vector_access(target, vtype, vl) != ERROR_OK)
 		return ERROR_FAIL;
 
-	if (cleanup_after_register_access(target, mstatus, regno) != ERROR_OK)
+	if (cleanup_after_register_access(target, mstatus, regids[0]) != ERROR_OK)
 		return ERROR_FAIL;
 	if (register_write_direct(target, GDB_REGNO_S0, s0) != ERROR_OK)
 		return ERROR_FAIL;
+	if (register_write_direct(target, GDB_REGNO_S1, s1) != ERROR_OK)
+		return ERROR_FAIL;
 
 	return result;
 }
 
+static int riscv013_get_register_buf(struct target *target,
+		uint8_t *value, int regno)
+{
+	return riscv013_get_register_bufs(target, 1, &regno, &value);
+}
+
 static int riscv013_set_register_buf(struct target *target,
 		int regno, const uint8_t *value)
 {
@@ -1978,21 +2279,8 @@ static int riscv013_set_register_buf(struct target *target,
 	if (prep_for_vector_access(target, &vtype, &vl, &debug_vl) != ERROR_OK)
 		return ERROR_FAIL;
 
-	unsigned vnum = regno - GDB_REGNO_V0;
-	unsigned xlen = riscv_xlen(target);
-
-	struct riscv_program program;
-	riscv_program_init(&program, target);
-	riscv_program_insert(&program, vslide1down_vx(vnum, vnum, S0, true));
-	int result = ERROR_OK;
-	for (unsigned i = 0; i < debug_vl; i++) {
-		if (register_write_direct(target, GDB_REGNO_S0,
-					buf_get_u64(value, xlen * i, xlen)) != ERROR_OK)
-			return ERROR_FAIL;
-		result = riscv_program_exec(&program, target);
-		if (result != ERROR_OK)
-			break;
-	}
+	int result = write_vector_register(target, regno - GDB_REGNO_V0, value,
+			debug_vl);
 
 	if (cleanup_after_vector_access(target, vtype, vl) != ERROR_OK)
 		return ERROR_FAIL;
@@ -2012,11 +2300,14 @@ static int init_target(struct command_context *cmd_ctx,
 	riscv_info_t *generic_info = (riscv_info_t *) target->arch_info;
 
 	generic_info->get_register = &riscv013_get_register;
+	generic_info->get_registers = &riscv013_get_registers;
 	generic_info->set_register = &riscv013_set_register;
 	generic_info->get_register_buf = &riscv013_get_register_buf;
+	generic_info->get_register_bufs = &riscv013_get_register_bufs;
 	generic_info->set_register_buf = &riscv013_set_register_buf;
 	generic_info->select_current_hart = &riscv013_select_current_hart;
 	generic_info->is_halted = &riscv013_is_halted;
+	generic_info->poll_halted = &riscv013_poll_halted;
 	generic_info->resume_go = &riscv013_resume_go;
 	generic_info->step_current_hart = &riscv013_step_current_hart;
 	generic_info->on_halt = &riscv013_on_halt;
@@ -2039,6 +2330,7 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->read_memory = read_memory;
 	generic_info->test_sba_config_reg = &riscv013_test_sba_config_reg;
 	generic_info->test_compliance = &riscv013_test_compliance;
+	generic_info->print_mem_access_methods = &riscv013_print_mem_access_methods;
 	generic_info->hart_count = &riscv013_hart_count;
 	generic_info->data_bits = &riscv013_data_bits;
 	generic_info->version_specific = calloc(1, sizeof(riscv013_info_t));
@@ -2052,6 +2344,12 @@ static int init_target(struct command_context *cmd_ctx,
 	info->bus_master_read_delay = 0;
 	info->bus_master_write_delay = 0;
 	info->ac_busy_delay = 0;
+	info->read_batch_depth = BATCH_INITIAL_DEPTH;
+	info->sba_batch_depth = BATCH_INITIAL_DEPTH;
+	for (unsigned int i = 0; i < MEM_ACCESS_SIZES; i++) {
+		info->mem_read_method[i] = MEM_ACCESS_DEFAULT;
+		info->mem_write_method[i] = MEM_ACCESS_DEFAULT;
+	}
 
 	/* Assume all these abstract commands are supported until we learn
 	 * otherwise.
@@ -2343,6 +2641,31 @@ static int read_sbcs_nonbusy(struct target *target, uint32_t *sbcs)
 	}
 }
 
+/**
+ * Return the batch reused by the memory accesses of this target, emptied and
+ * set up with "idle" JTAG idle cycles between scans. It is allocated on first
+ * use, large enough for BATCH_MAX_DEPTH 64-bit reads followed by a status read.
+ */
+static struct riscv_batch *get_batch(struct target *target, size_t idle)
+{
+	RISCV013_INFO(info);
+	if (!info->batch) {
+		info->batch = riscv_batch_alloc(target, 2 * BATCH_MAX_DEPTH + 1, 0);
+		if (!info->batch)
+			return NULL;
+	}
+	riscv_batch_reset(info->batch, idle);
+	return info->batch;
+}
+
+static void adapt_batch_depth(unsigned int *depth, bool busy)
+{
+	if (busy)
+		*depth = MAX(*depth / 2, BATCH_MIN_DEPTH);
+	else
+		*depth = MIN(*depth * 2, BATCH_MAX_DEPTH);
+}
+
 static int modify_privilege(struct target *target, uint64_t *mstatus, uint64_t *mstatus_old)
 {
 	if (riscv_enable_virtual && has_sufficient_progbuf(target, 5)) {
@@ -2456,6 +2779,14 @@ static int read_memory_bus_v0(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
+static void log_transfer_rate(const char *mode, uint32_t bytes, int64_t start_ms)
+{
+	int64_t elapsed_ms = timeval_ms() - start_ms;
+	LOG_DEBUG("%s: %" PRIu32 " bytes in %" PRId64 " ms (%" PRId64 " bytes/s)",
+			mode, bytes, elapsed_ms,
+			elapsed_ms > 0 ? (int64_t)bytes * 1000 / elapsed_ms : 0);
+}
+
 /**
  * Read the requested memory using the system bus interface.
  */
@@ -2468,21 +2799,27 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 	}
 
 	RISCV013_INFO(info);
-	target_addr_t next_address = address;
-	target_addr_t end_address = address + count * size;
-
-	while (next_address < end_address) {
+	static int sbdata[4] = {DM_SBDATA0, DM_SBDATA1, DM_SBDATA2, DM_SBDATA3};
+	assert(size <= 16);
+	const unsigned int sbdata_count = (size + 3) / 4;
+	int64_t start_ms = timeval_ms();
+
+	/* next_index is the first element not read yet, and every element before
+	 * good_index was read while the bus master reported no error. */
+	uint32_t next_index = 0;
+	uint32_t good_index = 0;
+	while (next_index < count) {
 		uint32_t sbcs_write = set_field(0, DM_SBCS_SBREADONADDR, 1);
 		sbcs_write |= sb_sbaccess(size);
 		if (increment == size)
 			sbcs_write = set_field(sbcs_write, DM_SBCS_SBAUTOINCREMENT, 1);
-		if (count > 1)
-			sbcs_write = set_field(sbcs_write, DM_SBCS_SBREADONDATA, count > 1);
+		if (count - next_index > 1)
+			sbcs_write = set_field(sbcs_write, DM_SBCS_SBREADONDATA, 1);
 		if (dmi_write(target, DM_SBCS, sbcs_write) != ERROR_OK)
 			return ERROR_FAIL;
 
 		/* This address write will trigger the first read. */
-		if (sb_write_address(target, next_address) != ERROR_OK)
+		if (sb_write_address(target, address + next_index * increment) != ERROR_OK)
 			return ERROR_FAIL;
 
 		if (info->bus_master_read_delay) {
@@ -2493,102 +2830,139 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 			}
 		}
 
-		/* First value has been read, and is waiting for us to issue a DMI read
-		 * to get it. */
-
-		static int sbdata[4] = {DM_SBDATA0, DM_SBDATA1, DM_SBDATA2, DM_SBDATA3};
-		assert(size <= 16);
-		target_addr_t next_read = address - 1;
-		for (uint32_t i = (next_address - address) / size; i < count - 1; i++) {
-			for (int j = (size - 1) / 4; j >= 0; j--) {
-				uint32_t value;
-				unsigned attempt = 0;
-				while (1) {
-					if (attempt++ > 100) {
-						LOG_ERROR("DMI keeps being busy in while reading memory just past " TARGET_ADDR_FMT,
-								  next_read);
-						return ERROR_FAIL;
-					}
-					dmi_status_t status = dmi_scan(target, NULL, &value,
-												   DMI_OP_READ, sbdata[j], 0, false);
-					if (status == DMI_STATUS_BUSY)
-						increase_dmi_busy_delay(target);
-					else if (status == DMI_STATUS_SUCCESS)
-						break;
-					else
-						return ERROR_FAIL;
-				}
-				if (next_read != address - 1) {
-					buf_set_u32(buffer + next_read - address, 0, 8 * MIN(size, 4), value);
-					log_memory_access(next_read, value, MIN(size, 4), true);
-				}
-				next_read = address + i * size + j * 4;
+		/* Stream all but the last element: reading sbdata0 returns one element
+		 * and starts reading the next. Every batch ends with a read of sbcs, so
+		 * streaming stops as soon as the bus master could not keep up, without
+		 * waiting for it between batches otherwise. */
+		bool dmi_busy = false;
+		bool streaming = next_index < count - 1;
+		bool sbcs_read_valid = false;
+		uint32_t sbcs_read = 0;
+		while (next_index < count - 1) {
+			struct riscv_batch *batch = get_batch(target,
+					info->dmi_busy_delay + info->bus_master_read_delay);
+			if (!batch)
+				return ERROR_FAIL;
+
+			uint32_t reads = 0;
+			while (next_index + reads < count - 1 &&
+					reads < info->sba_batch_depth &&
+					riscv_batch_available_scans(batch) > sbdata_count) {
+				for (int j = sbdata_count - 1; j >= 0; j--)
+					riscv_batch_add_dmi_read(batch, sbdata[j]);
+				reads++;
 			}
-		}
+			size_t sbcs_key = riscv_batch_add_dmi_read(batch, DM_SBCS);
 
-		uint32_t sbcs_read = 0;
-		if (count > 1) {
-			uint32_t value;
-			unsigned attempt = 0;
-			while (1) {
-				if (attempt++ > 100) {
-					LOG_ERROR("DMI keeps being busy in while reading memory just past " TARGET_ADDR_FMT,
-								next_read);
-					return ERROR_FAIL;
+			if (batch_run(target, batch) != ERROR_OK)
+				return ERROR_FAIL;
+
+			/* After DMI busy the DTM ignores every operation until dmireset, so
+			 * only the elements read before it are good, and the bus master did
+			 * not start reading past them. */
+			size_t key = 0;
+			for (uint32_t i = 0; i < reads && !dmi_busy; i++) {
+				uint32_t value[4];
+				for (int j = sbdata_count - 1; j >= 0; j--, key++) {
+					if (riscv_batch_get_dmi_read_op(batch, key) != DMI_STATUS_SUCCESS)
+						dmi_busy = true;
+					value[j] = riscv_batch_get_dmi_read_data(batch, key);
 				}
-				dmi_status_t status = dmi_scan(target, NULL, &value, DMI_OP_NOP, 0, 0, false);
-				if (status == DMI_STATUS_BUSY)
-					increase_dmi_busy_delay(target);
-				else if (status == DMI_STATUS_SUCCESS)
+				if (dmi_busy)
 					break;
-				else
-					return ERROR_FAIL;
+				for (unsigned int j = 0; j < sbdata_count; j++) {
+					buf_set_u32(buffer + next_index * size + j * 4, 0,
+							8 * MIN(size, 4), value[j]);
+					log_memory_access(address + next_index * increment + j * 4,
+							value[j], MIN(size, 4), true);
+				}
+				next_index++;
 			}
-			buf_set_u32(buffer + next_read - address, 0, 8 * MIN(size, 4), value);
-			log_memory_access(next_read, value, MIN(size, 4), true);
 
-			/* "Writes to sbcs while sbbusy is high result in undefined behavior.
-			 * A debugger must not write to sbcs until it reads sbbusy as 0." */
+			sbcs_read_valid = !dmi_busy &&
+				riscv_batch_get_dmi_read_op(batch, sbcs_key) == DMI_STATUS_SUCCESS;
+			if (!sbcs_read_valid) {
+				dmi_busy = true;
+				break;
+			}
+			sbcs_read = riscv_batch_get_dmi_read_data(batch, sbcs_key);
+			if (get_field(sbcs_read, DM_SBCS_SBBUSYERROR) ||
+					get_field(sbcs_read, DM_SBCS_SBERROR))
+				break;
+			good_index = next_index;
+			adapt_batch_depth(&info->sba_batch_depth, false);
+		}
+
+		/* "Writes to sbcs while sbbusy is high result in undefined behavior.
+		 * A debugger must not write to sbcs until it reads sbbusy as 0."
+		 * If DMI was busy, the dmi_read() here also increments dmi_busy_delay.
+		 * A single element is read as before, with one wait after it. */
+		if (streaming && (!sbcs_read_valid || get_field(sbcs_read, DM_SBCS_SBBUSY))) {
 			if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
 				return ERROR_FAIL;
+		}
 
-			sbcs_write = set_field(sbcs_write, DM_SBCS_SBREADONDATA, 0);
-			if (dmi_write(target, DM_SBCS, sbcs_write) != ERROR_OK)
+		if (get_field(sbcs_read, DM_SBCS_SBBUSYERROR)) {
+			/* We read while the target was busy. Slow down, and read again from
+			 * the element that was being read when it happened. Without
+			 * autoincrement, there is no telling which one that was. */
+			if (dmi_write(target, DM_SBCS, DM_SBCS_SBBUSYERROR) != ERROR_OK)
 				return ERROR_FAIL;
+			uint32_t resume_index = good_index;
+			if (increment == size) {
+				target_addr_t sbaddress = sb_read_address(target);
+				if (sbaddress >= address + size)
+					resume_index = (sbaddress - address) / size - 1;
+			}
+			next_index = MIN(next_index, MAX(resume_index, good_index));
+			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
+			adapt_batch_depth(&info->sba_batch_depth, true);
+			continue;
 		}
 
-		/* Read the last word, after we disabled sbreadondata if necessary. */
-		if (!get_field(sbcs_read, DM_SBCS_SBERROR) &&
-				!get_field(sbcs_read, DM_SBCS_SBBUSYERROR)) {
-			if (read_memory_bus_word(target, address + (count - 1) * size, size,
-						buffer + (count - 1) * size) != ERROR_OK)
+		if (get_field(sbcs_read, DM_SBCS_SBERROR)) {
+			/* Some error indicating the bus access failed, but not because of
+			 * something we did wrong. */
+			if (dmi_write(target, DM_SBCS, DM_SBCS_SBERROR) != ERROR_OK)
 				return ERROR_FAIL;
+			return ERROR_FAIL;
+		}
 
-			if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
+		good_index = next_index;
+		if (dmi_busy) {
+			/* Start again from the first element we did not get. */
+			adapt_batch_depth(&info->sba_batch_depth, true);
+			continue;
+		}
+
+		/* Read the last element, after disabling sbreadondata if necessary so
+		 * no read past it is started. */
+		if (get_field(sbcs_write, DM_SBCS_SBREADONDATA)) {
+			sbcs_write = set_field(sbcs_write, DM_SBCS_SBREADONDATA, 0);
+			if (dmi_write(target, DM_SBCS, sbcs_write) != ERROR_OK)
 				return ERROR_FAIL;
 		}
+		if (read_memory_bus_word(target, address + next_index * increment, size,
+					buffer + next_index * size) != ERROR_OK)
+			return ERROR_FAIL;
+		if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
+			return ERROR_FAIL;
 
 		if (get_field(sbcs_read, DM_SBCS_SBBUSYERROR)) {
-			/* We read while the target was busy. Slow down and try again. */
 			if (dmi_write(target, DM_SBCS, DM_SBCS_SBBUSYERROR) != ERROR_OK)
 				return ERROR_FAIL;
-			next_address = sb_read_address(target);
 			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
 			continue;
 		}
-
-		unsigned error = get_field(sbcs_read, DM_SBCS_SBERROR);
-		if (error == 0) {
-			next_address = end_address;
-		} else {
-			/* Some error indicating the bus access failed, but not because of
-			 * something we did wrong. */
+		if (get_field(sbcs_read, DM_SBCS_SBERROR)) {
 			if (dmi_write(target, DM_SBCS, DM_SBCS_SBERROR) != ERROR_OK)
 				return ERROR_FAIL;
 			return ERROR_FAIL;
 		}
+		next_index++;
 	}
 
+	log_transfer_rate("sba v1 read", count * size, start_ms);
 	return ERROR_OK;
 }
 
@@ -2792,30 +3166,41 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 		 * dm_data0 contains[read_addr-size*2]
 		 */
 
-		struct riscv_batch *batch = riscv_batch_alloc(target, 32,
+		struct riscv_batch *batch = get_batch(target,
 				info->dmi_busy_delay + info->ac_busy_delay);
 		if (!batch)
 			return ERROR_FAIL;
 
 		unsigned reads = 0;
-		for (unsigned j = index; j < count; j++) {
+		for (unsigned j = index; j < count && reads < info->read_batch_depth; j++) {
 			if (size > 4)
 				riscv_batch_add_dmi_read(batch, DM_DATA1);
 			riscv_batch_add_dmi_read(batch, DM_DATA0);
 
 			reads++;
-			if (riscv_batch_full(batch))
-				break;
 		}
 
-		batch_run(target, batch);
+		/* Reading abstractcs in the same batch usually tells whether the
+		 * target kept up, without another JTAG round trip. */
+		size_t abstractcs_read = riscv_batch_add_dmi_read(batch, DM_ABSTRACTCS);
+
+		if (batch_run(target, batch) != ERROR_OK) {
+			result = ERROR_FAIL;
+			goto error;
+		}
 
 		/* Wait for the target to finish performing the last abstract command,
-		 * and update our copy of cmderr. If we see that DMI is busy here,
-		 * dmi_busy_delay will be incremented. */
+		 * and update our copy of cmderr. If the batch ran into DMI busy, the
+		 * dmi_read() here sees it and dmi_busy_delay will be incremented. */
+		bool busy = false;
 		uint32_t abstractcs;
-		if (dmi_read(target, &abstractcs, DM_ABSTRACTCS) != ERROR_OK)
-			return ERROR_FAIL;
+		if (riscv_batch_get_dmi_read_op(batch, abstractcs_read) == DMI_STATUS_SUCCESS) {
+			abstractcs = riscv_batch_get_dmi_read_data(batch, abstractcs_read);
+		} else {
+			busy = true;
+			if (dmi_read(target, &abstractcs, DM_ABSTRACTCS) != ERROR_OK)
+				return ERROR_FAIL;
+		}
 		while (get_field(abstractcs, DM_ABSTRACTCS_BUSY))
 			if (dmi_read(target, &abstractcs, DM_ABSTRACTCS) != ERROR_OK)
 				return ERROR_FAIL;
@@ -2831,6 +3216,7 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 			case CMDERR_BUSY:
 				LOG_DEBUG("memory read resulted in busy response");
 
+				busy = true;
 				increase_ac_busy_delay(target);
 				riscv013_clear_abstract_error(target);
 
@@ -2840,14 +3226,10 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 				/* This is definitely a good version of the value that we
 				 * attempted to read when we discovered that the target was
 				 * busy. */
-				if (dmi_read(target, &dmi_data0, DM_DATA0) != ERROR_OK) {
-					riscv_batch_free(batch);
+				if (dmi_read(target, &dmi_data0, DM_DATA0) != ERROR_OK)
 					goto error;
-				}
-				if (size > 4 && dmi_read(target, &dmi_data1, DM_DATA1) != ERROR_OK) {
-					riscv_batch_free(batch);
+				if (size > 4 && dmi_read(target, &dmi_data1, DM_DATA1) != ERROR_OK)
 					goto error;
-				}
 
 				/* See how far we got, clobbering dmi_data0. */
 				if (increment == 0) {
@@ -2860,10 +3242,8 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 												  GDB_REGNO_S0);
 					next_index = (next_read_addr - address) / increment;
 				}
-				if (result != ERROR_OK) {
-					riscv_batch_free(batch);
+				if (result != ERROR_OK)
 					goto error;
-				}
 
 				uint64_t value64 = (((uint64_t)dmi_data1) << 32) | dmi_data0;
 				buf_set_u64(buffer + (next_index - 2) * size, 0, 8 * size, value64);
@@ -2884,7 +3264,6 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 			default:
 				LOG_DEBUG("error when reading memory, abstractcs=0x%08lx", (long)abstractcs);
 				riscv013_clear_abstract_error(target);
-				riscv_batch_free(batch);
 				result = ERROR_FAIL;
 				goto error;
 		}
@@ -2914,7 +3293,7 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 				 * caller to reread the entire block. */
 				LOG_WARNING("Batch memory read encountered DMI error %d. "
 						"Falling back on slower reads.", status);
-				riscv_batch_free(batch);
+				adapt_batch_depth(&info->read_batch_depth, true);
 				result = ERROR_FAIL;
 				goto error;
 			}
@@ -2923,7 +3302,7 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 				if (status != DMI_STATUS_SUCCESS) {
 					LOG_WARNING("Batch memory read encountered DMI error %d. "
 							"Falling back on slower reads.", status);
-					riscv_batch_free(batch);
+					adapt_batch_depth(&info->read_batch_depth, true);
 					result = ERROR_FAIL;
 					goto error;
 				}
@@ -2938,7 +3317,7 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 
 		index = next_index;
 
-		riscv_batch_free(batch);
+		adapt_batch_depth(&info->read_batch_depth, busy);
 	}
 
 	dmi_write(target, DM_ABSTRACTAUTO, 0);
@@ -3162,6 +3541,100 @@ static int read_memory_progbuf(struct target *target, target_addr_t address,
 	return result;
 }
 
+static bool sba_supports_size(struct target *target, uint32_t size)
+{
+	RISCV013_INFO(info);
+	return (get_field(info->sbcs, DM_SBCS_SBACCESS8) && size == 1) ||
+			(get_field(info->sbcs, DM_SBCS_SBACCESS16) && size == 2) ||
+			(get_field(info->sbcs, DM_SBCS_SBACCESS32) && size == 4) ||
+			(get_field(info->sbcs, DM_SBCS_SBACCESS64) && size == 8) ||
+			(get_field(info->sbcs, DM_SBCS_SBACCESS128) && size == 16);
+}
+
+/* Return the index of size in the calibration results, or -1. */
+static int mem_access_size_index(uint32_t size)
+{
+	for (int i = 0; i < MEM_ACCESS_SIZES; i++) {
+		if (size == 1u << i)
+			return i;
+	}
+	return -1;
+}
+
+static bool mem_access_supported(struct target *target,
+		mem_access_method_t method, uint32_t size)
+{
+	RISCV013_INFO(info);
+	switch (method) {
+		case MEM_ACCESS_PROGBUF:
+			return has_sufficient_progbuf(target, 3) &&
+				size * 8 <= (unsigned)riscv_xlen(target);
+		case MEM_ACCESS_SYSBUS:
+			return sba_supports_size(target, size) &&
+				get_field(info->sbcs, DM_SBCS_SBVERSION) <= 1;
+		case MEM_ACCESS_ABSTRACT:
+			return size <= 8;
+		default:
+			return false;
+	}
+}
+
+/* Whether method can do this access at all, as opposed to failing while
+ * doing it. Only then does read_memory() fall back on another method. */
+static bool mem_access_can_attempt(struct target *target,
+		mem_access_method_t method, uint32_t size, uint32_t increment)
+{
+	if (!mem_access_supported(target, method, size))
+		return false;
+
+	RISCV013_INFO(info);
+	switch (method) {
+		case MEM_ACCESS_SYSBUS:
+			if (get_field(info->sbcs, DM_SBCS_SBVERSION) == 0)
+				return increment == size;
+			return increment == size || increment == 0;
+		case MEM_ACCESS_ABSTRACT:
+			return increment == size;
+		default:
+			return true;
+	}
+}
+
+/* Calibration has to be asked for with riscv set_calibrate_mem_access: it
+ * may pick System Bus Access, which bypasses the caches of the hart. It only
+ * applies to physical accesses. With riscv_enable_virtual, progbuf accesses
+ * may go through the MMU while the others do not, so only the usual choice
+ * knows how an address is to be accessed. An explicit riscv set_prefer_sba
+ * also overrides calibration. */
+static bool mem_access_calibrated(struct target *target)
+{
+	return riscv_calibrate_mem_access && !riscv_prefer_sba_set &&
+		!(riscv_enable_virtual && has_sufficient_progbuf(target, 5));
+}
+
+static int read_memory_by_method(struct target *target,
+		mem_access_method_t method, target_addr_t address, uint32_t size,
+		uint32_t count, uint8_t *buffer, uint32_t increment)
+{
+	RISCV013_INFO(info);
+	switch (method) {
+		case MEM_ACCESS_PROGBUF:
+			return read_memory_progbuf(target, address, size, count, buffer,
+				increment);
+		case MEM_ACCESS_SYSBUS:
+			if (get_field(info->sbcs, DM_SBCS_SBVERSION) == 0)
+				return read_memory_bus_v0(target, address, size, count, buffer,
+					increment);
+			return read_memory_bus_v1(target, address, size, count, buffer,
+				increment);
+		case MEM_ACCESS_ABSTRACT:
+			return read_memory_abstract(target, address, size, count, buffer,
+				increment);
+		default:
+			return ERROR_FAIL;
+	}
+}
+
 static int read_memory(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, uint8_t *buffer, uint32_t increment)
 {
@@ -3169,15 +3642,24 @@ static int read_memory(struct target *target, target_addr_t address,
 		return ERROR_OK;
 
 	RISCV013_INFO(info);
+	/* Use the method calibration found fastest. Its errors are returned as
+	 * is: repeating the access another way could read side-effect registers
+	 * twice. Only if it cannot do this access at all, eg. because it does
+	 * not support this increment, fall back on the usual choice. */
+	int size_index = mem_access_size_index(size);
+	if (size_index >= 0 && mem_access_calibrated(target)) {
+		mem_access_method_t method = info->mem_read_method[size_index];
+		if (method != MEM_ACCESS_DEFAULT &&
+				mem_access_can_attempt(target, method, size, increment))
+			return read_memory_by_method(target, method, address, size, count,
+					buffer, increment);
+	}
+
 	if (has_sufficient_progbuf(target, 3) && !riscv_prefer_sba)
 		return read_memory_progbuf(target, address, size, count, buffer,
 			increment);
 
-	if ((get_field(info->sbcs, DM_SBCS_SBACCESS8) && size == 1) ||
-			(get_field(info->sbcs, DM_SBCS_SBACCESS16) && size == 2) ||
-			(get_field(info->sbcs, DM_SBCS_SBACCESS32) && size == 4) ||
-			(get_field(info->sbcs, DM_SBCS_SBACCESS64) && size == 8) ||
-			(get_field(info->sbcs, DM_SBCS_SBACCESS128) && size == 16)) {
+	if (sba_supports_size(target, size)) {
 		if (get_field(info->sbcs, DM_SBCS_SBVERSION) == 0)
 			return read_memory_bus_v0(target, address, size, count, buffer,
 				increment);
@@ -3251,6 +3733,7 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, const uint8_t *buffer)
 {
 	RISCV013_INFO(info);
+	int64_t start_ms = timeval_ms();
 	uint32_t sbcs = sb_sbaccess(size);
 	sbcs = set_field(sbcs, DM_SBCS_SBAUTOINCREMENT, 1);
 	dmi_write(target, DM_SBCS, sbcs);
@@ -3265,17 +3748,18 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 		LOG_DEBUG("transferring burst starting at address 0x%" TARGET_PRIxADDR,
 				next_address);
 
-		struct riscv_batch *batch = riscv_batch_alloc(
-				target,
-				32,
+		struct riscv_batch *batch = get_batch(target,
 				info->dmi_busy_delay + info->bus_master_write_delay);
 		if (!batch)
 			return ERROR_FAIL;
 
-		for (uint32_t i = (next_address - address) / size; i < count; i++) {
+		uint32_t first = (next_address - address) / size;
+		for (uint32_t i = first; i < count; i++) {
 			const uint8_t *p = buffer + i * size;
 
-			if (riscv_batch_available_scans(batch) < (size + 3) / 4)
+			/* Leave room for the read of sbcs. */
+			if (riscv_batch_available_scans(batch) <= (size + 3) / 4 ||
+					i - first >= info->sba_batch_depth)
 				break;
 
 			if (size > 12)
@@ -3310,18 +3794,27 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 			next_address += size;
 		}
 
+		/* Reading sbcs in the same batch usually tells whether the bus
+		 * master kept up, without another JTAG round trip. */
+		size_t sbcs_read = riscv_batch_add_dmi_read(batch, DM_SBCS);
+
 		result = batch_run(target, batch);
-		riscv_batch_free(batch);
 		if (result != ERROR_OK)
 			return result;
 
-		bool dmi_busy_encountered;
-		if (dmi_op(target, &sbcs, &dmi_busy_encountered, DMI_OP_READ,
-				DM_SBCS, 0, false, false) != ERROR_OK)
-			return ERROR_FAIL;
+		bool dmi_busy_encountered = false;
+		if (riscv_batch_get_dmi_read_op(batch, sbcs_read) == DMI_STATUS_SUCCESS) {
+			sbcs = riscv_batch_get_dmi_read_data(batch, sbcs_read);
+		} else {
+			/* The batch ran into DMI busy, so some writes were dropped. */
+			if (dmi_op(target, &sbcs, NULL, DMI_OP_READ,
+					DM_SBCS, 0, false, true) != ERROR_OK)
+				return ERROR_FAIL;
+			dmi_busy_encountered = true;
+		}
 
 		time_t start = time(NULL);
-		bool dmi_busy = dmi_busy_encountered;
+		bool dmi_busy = false;
 		while (get_field(sbcs, DM_SBCS_SBBUSY) || dmi_busy) {
 			if (time(NULL) - start > riscv_command_timeout_sec) {
 				LOG_ERROR("Timed out after %ds waiting for sbbusy to go low (sbcs=0x%x). "
@@ -3342,6 +3835,8 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 		}
 
 		if (get_field(sbcs, DM_SBCS_SBBUSYERROR) || dmi_busy_encountered) {
+			/* Write again from the first element the bus master dropped. */
+			adapt_batch_depth(&info->sba_batch_depth, true);
 			next_address = sb_read_address(target);
 			if (next_address < address) {
 				/* This should never happen, probably buggy hardware. */
@@ -3360,8 +3855,10 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 			dmi_write(target, DM_SBCS, DM_SBCS_SBERROR);
 			return ERROR_FAIL;
 		}
+		adapt_batch_depth(&info->sba_batch_depth, false);
 	}
 
+	log_transfer_rate("sba v1 write", count * size, start_ms);
 	return ERROR_OK;
 }
 
@@ -3557,19 +4054,44 @@ error:
 	return result;
 }
 
+static int write_memory_by_method(struct target *target,
+		mem_access_method_t method, target_addr_t address, uint32_t size,
+		uint32_t count, const uint8_t *buffer)
+{
+	RISCV013_INFO(info);
+	switch (method) {
+		case MEM_ACCESS_PROGBUF:
+			return write_memory_progbuf(target, address, size, count, buffer);
+		case MEM_ACCESS_SYSBUS:
+			if (get_field(info->sbcs, DM_SBCS_SBVERSION) == 0)
+				return write_memory_bus_v0(target, address, size, count, buffer);
+			return write_memory_bus_v1(target, address, size, count, buffer);
+		case MEM_ACCESS_ABSTRACT:
+			return write_memory_abstract(target, address, size, count, buffer);
+		default:
+			return ERROR_FAIL;
+	}
+}
+
 static int write_memory(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, const uint8_t *buffer)
 {
 	RISCV013_INFO(info);
 
+	/* See read_memory() */
+	int size_index = mem_access_size_index(size);
+	if (size_index >= 0 && mem_access_calibrated(target)) {
+		mem_access_method_t method = info->mem_write_method[size_index];
+		if (method != MEM_ACCESS_DEFAULT &&
+				mem_access_can_attempt(target, method, size, size))
+			return write_memory_by_method(target, method, address, size, count,
+					buffer);
+	}
+
 	if (has_sufficient_progbuf(target, 3) && !riscv_prefer_sba)
 		return write_memory_progbuf(target, address, size, count, buffer);
 
-	if ((get_field(info->sbcs, DM_SBCS_SBACCESS8) && size == 1) ||
-			(get_field(info->sbcs, DM_SBCS_SBACCESS16) && size == 2) ||
-			(get_field(info->sbcs, DM_SBCS_SBACCESS32) && size == 4) ||
-			(get_field(info->sbcs, DM_SBCS_SBACCESS64) && size == 8) ||
-			(get_field(info->sbcs, DM_SBCS_SBACCESS128) && size == 16)) {
+	if (sba_supports_size(target, size)) {
 		if (get_field(info->sbcs, DM_SBCS_SBVERSION) == 0)
 			return write_memory_bus_v0(target, address, size, count, buffer);
 		else if (get_field(info->sbcs, DM_SBCS_SBVERSION) == 1)
@@ -3582,6 +4104,127 @@ static int write_memory(struct target *target, target_addr_t address,
 	return write_memory_abstract(target, address, size, count, buffer);
 }
 
+static uint32_t mem_access_rate(const struct duration *bench, uint32_t bytes)
+{
+	float elapsed = duration_elapsed(bench);
+	if (elapsed <= 0 || bytes / elapsed >= UINT32_MAX)
+		return UINT32_MAX;
+	return MAX(bytes / elapsed, 1);
+}
+
+/**
+ * Measure how fast each memory access method reads and writes the work area,
+ * for each access size, and use the fastest from now on. The content of the
+ * work area is preserved. Without a physical work area, or if the methods
+ * fail, memory accesses keep being done the usual way.
+ */
+static void calibrate_mem_access(struct target *target)
+{
+	RISCV013_INFO(info);
+	for (unsigned int i = 0; i < MEM_ACCESS_SIZES; i++) {
+		info->mem_read_method[i] = MEM_ACCESS_DEFAULT;
+		info->mem_write_method[i] = MEM_ACCESS_DEFAULT;
+	}
+	memset(info->mem_read_rate, 0, sizeof(info->mem_read_rate));
+	memset(info->mem_write_rate, 0, sizeof(info->mem_write_rate));
+
+	target_addr_t address = target->working_area_phys;
+	uint32_t bytes = MIN(target->working_area_size, MEM_ACCESS_CALIBRATION_BYTES) & ~15u;
+	if (!target->working_area_phys_spec || !bytes || address % 4) {
+		LOG_DEBUG("No aligned -work-area-phys; not calibrating memory accesses.");
+		return;
+	}
+	if (!mem_access_calibrated(target)) {
+		LOG_DEBUG("Calibration is off, memory accesses may be virtual or "
+				"riscv set_prefer_sba was used; not calibrating memory accesses.");
+		return;
+	}
+
+	uint8_t saved[MEM_ACCESS_CALIBRATION_BYTES];
+	uint8_t buffer[MEM_ACCESS_CALIBRATION_BYTES];
+	if (read_memory(target, address, 4, bytes / 4, saved, 4) != ERROR_OK) {
+		LOG_WARNING("Failed to read the work area; not calibrating memory accesses.");
+		return;
+	}
+
+	for (unsigned int i = 0; i < MEM_ACCESS_SIZES; i++) {
+		uint32_t size = 1 << i;
+		if (address % size)
+			continue;
+
+		for (mem_access_method_t method = 0; method < MEM_ACCESS_METHODS; method++) {
+			if (!mem_access_supported(target, method, size))
+				continue;
+
+			struct duration bench;
+			duration_start(&bench);
+			int result = read_memory_by_method(target, method, address, size,
+					bytes / size, buffer, size);
+			duration_measure(&bench);
+			if (result == ERROR_OK && !memcmp(buffer, saved, bytes))
+				info->mem_read_rate[i][method] = mem_access_rate(&bench, bytes);
+
+			duration_start(&bench);
+			result = write_memory_by_method(target, method, address, size,
+					bytes / size, saved);
+			duration_measure(&bench);
+			if (result == ERROR_OK &&
+					read_memory(target, address, 4, bytes / 4, buffer, 4) == ERROR_OK &&
+					!memcmp(buffer, saved, bytes)) {
+				info->mem_write_rate[i][method] = mem_access_rate(&bench, bytes);
+			} else if (write_memory(target, address, 4, bytes / 4, saved) != ERROR_OK) {
+				LOG_ERROR("Failed to restore the work area at 0x%" TARGET_PRIxADDR
+						" after measuring %s writes.", address,
+						mem_access_method_name[method]);
+			}
+
+			LOG_DEBUG("%d-byte %s accesses: read %u bytes/s, write %u bytes/s",
+					size, mem_access_method_name[method],
+					info->mem_read_rate[i][method], info->mem_write_rate[i][method]);
+		}
+
+		for (mem_access_method_t method = 0; method < MEM_ACCESS_METHODS; method++) {
+			mem_access_method_t *best = &info->mem_read_method[i];
+			if (info->mem_read_rate[i][method] &&
+					(*best == MEM_ACCESS_DEFAULT ||
+					 info->mem_read_rate[i][method] > info->mem_read_rate[i][*best]))
+				*best = method;
+			best = &info->mem_write_method[i];
+			if (info->mem_write_rate[i][method] &&
+					(*best == MEM_ACCESS_DEFAULT ||
+					 info->mem_write_rate[i][method] > info->mem_write_rate[i][*best]))
+				*best = method;
+		}
+	}
+}
+
+static int riscv013_print_mem_access_methods(struct target *target,
+		struct command_invocation *cmd)
+{
+	RISCV013_INFO(info);
+	for (unsigned int i = 0; i < MEM_ACCESS_SIZES; i++) {
+		for (int write = 0; write < 2; write++) {
+			mem_access_method_t chosen = write ? info->mem_write_method[i] :
+				info->mem_read_method[i];
+			const uint32_t *rate = write ? info->mem_write_rate[i] :
+				info->mem_read_rate[i];
+			char rates[128] = "";
+			size_t used = 0;
+			for (mem_access_method_t method = 0; method < MEM_ACCESS_METHODS; method++) {
+				if (rate[method])
+					used += snprintf(rates + used, sizeof(rates) - used, " %s=%u B/s",
+							mem_access_method_name[method], rate[method]);
+				else
+					used += snprintf(rates + used, sizeof(rates) - used, " %s=-",
+							mem_access_method_name[method]);
+			}
+			command_print(cmd, "%-5s %2d bytes: %-8s%s", write ? "write" : "read",
+					1 << i, mem_access_method_name[chosen], rates);
+		}
+	}
+	return ERROR_OK;
+}
+
 static int arch_state(struct target *target)
 {
 	return ERROR_OK;
@@ -3634,6 +4277,87 @@ static int riscv013_get_register(struct target *target,
 	return result;
 }
 
+/* Read registers with abstract commands queued in a single batch. Only GPRs,
+ * and FPRs and PC when they can be read with abstract commands, are supported.
+ * If any command fails, nothing is returned and the caller reads the registers
+ * one at a time, which also figures out what isn't supported. */
+static int riscv013_get_registers(struct target *target, int hartid,
+		unsigned count, const int *regids, riscv_reg_t *values)
+{
+	RISCV013_INFO(info);
+
+	riscv_set_current_hartid(target, hartid);
+
+	struct riscv_batch *batch = get_batch(target,
+			info->dmi_busy_delay + info->ac_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
+	if (3 * count + 1 > riscv_batch_available_scans(batch))
+		return ERROR_FAIL;
+
+	size_t data0_read[count], data1_read[count];
+	for (unsigned i = 0; i < count; i++) {
+		int number = regids[i] == GDB_REGNO_PC ? GDB_REGNO_DPC : regids[i];
+		if (number > GDB_REGNO_XPR31 &&
+				!(number >= GDB_REGNO_FPR0 && number <= GDB_REGNO_FPR31 &&
+					info->abstract_read_fpr_supported) &&
+				!(number == GDB_REGNO_DPC && info->abstract_read_csr_supported))
+			return ERROR_FAIL;
+
+		unsigned size = register_size(target, number);
+		if (size != 32 && size != 64)
+			return ERROR_FAIL;
+		riscv_batch_add_dmi_write(batch, DM_COMMAND,
+				access_register_command(target, number, size,
+					AC_ACCESS_REGISTER_TRANSFER));
+		data0_read[i] = riscv_batch_add_dmi_read(batch, DM_DATA0);
+		if (size > 32)
+			data1_read[i] = riscv_batch_add_dmi_read(batch, DM_DATA1);
+		else
+			data1_read[i] = data0_read[i];
+	}
+	size_t abstractcs_read = riscv_batch_add_dmi_read(batch, DM_ABSTRACTCS);
+
+	if (batch_run(target, batch) != ERROR_OK)
+		return ERROR_FAIL;
+
+	/* A command that fails leaves cmderr set, and the ones after it are not
+	 * executed, so abstractcs tells whether all the values are good. */
+	uint32_t abstractcs;
+	bool dmi_busy = riscv_batch_get_dmi_read_op(batch, abstractcs_read) !=
+		DMI_STATUS_SUCCESS;
+	if (dmi_busy) {
+		if (dmi_read(target, &abstractcs, DM_ABSTRACTCS) != ERROR_OK)
+			return ERROR_FAIL;
+	} else {
+		abstractcs = riscv_batch_get_dmi_read_data(batch, abstractcs_read);
+	}
+	while (get_field(abstractcs, DM_ABSTRACTCS_BUSY))
+		if (dmi_read(target, &abstractcs, DM_ABSTRACTCS) != ERROR_OK)
+			return ERROR_FAIL;
+	info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+	if (info->cmderr != CMDERR_NONE) {
+		LOG_DEBUG("Reading %d registers at once failed; abstractcs=0x%x",
+				count, abstractcs);
+		if (info->cmderr == CMDERR_BUSY)
+			increase_ac_busy_delay(target);
+		riscv013_clear_abstract_error(target);
+		return ERROR_FAIL;
+	}
+	if (dmi_busy)
+		return ERROR_FAIL;
+
+	for (unsigned i = 0; i < count; i++) {
+		values[i] = riscv_batch_get_dmi_read_data(batch, data0_read[i]);
+		if (data1_read[i] != data0_read[i])
+			values[i] |= (uint64_t) riscv_batch_get_dmi_read_data(batch,
+					data1_read[i]) << 32;
+		LOG_DEBUG("[%d] %s: 0x%" PRIx64, target->coreid,
+				gdb_regno_name(regids[i]), values[i]);
+	}
+	return ERROR_OK;
+}
+
 static int riscv013_set_register(struct target *target, int hid, int rid, uint64_t value)
 {
 	LOG_DEBUG("[%d] writing 0x%" PRIx64 " to register %s on hart %d",
@@ -3740,6 +4464,88 @@ static int select_prepped_harts(struct target *target, bool *use_hasel)
 	return ERROR_OK;
 }
 
+/* Read the halted state of every hart on the DM in a single batch: haltsum0
+ * for each window of 32 harts, and dmstatus with all the harts selected by the
+ * hart array mask, to notice harts that are unavailable or were reset. Those
+ * are left for riscv013_is_halted() to report, so halted_sampled stays false
+ * then. */
+static int sample_halted_harts(struct target *target)
+{
+	RISCV013_INFO(info);
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+	dm->halted_sampled = false;
+
+	unsigned window_count = (dm->hart_count + 31) / 32;
+	size_t haltsum_read[window_count];
+
+	struct riscv_batch *batch = get_batch(target, info->dmi_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
+	for (unsigned i = 0; i < window_count; i++) {
+		unsigned harts = MIN(dm->hart_count - i * 32, 32);
+		riscv_batch_add_dmi_write(batch, DM_HAWINDOWSEL, i);
+		riscv_batch_add_dmi_write(batch, DM_HAWINDOW,
+				harts == 32 ? 0xffffffff : (1u << harts) - 1);
+	}
+	riscv_batch_add_dmi_write(batch, DM_DMCONTROL,
+			DM_DMCONTROL_DMACTIVE | DM_DMCONTROL_HASEL);
+	size_t dmstatus_read = riscv_batch_add_dmi_read(batch, DM_DMSTATUS);
+	for (unsigned i = 0; i < window_count; i++) {
+		riscv_batch_add_dmi_write(batch, DM_DMCONTROL,
+				set_hartsel(DM_DMCONTROL_DMACTIVE, i * 32));
+		haltsum_read[i] = riscv_batch_add_dmi_read(batch, DM_HALTSUM0);
+	}
+	dm->current_hartid = (window_count - 1) * 32;
+
+	/* After DMI busy every access is dropped, so checking the last one is
+	 * enough. */
+	if (batch_run(target, batch) != ERROR_OK ||
+			riscv_batch_get_dmi_read_op(batch, haltsum_read[window_count - 1]) !=
+				DMI_STATUS_SUCCESS) {
+		LOG_DEBUG("Failed to read the halted state of all harts at once.");
+		/* Don't leave the hart array mask in use. */
+		dm->current_hartid = 0;
+		return dmi_write(target, DM_DMCONTROL, DM_DMCONTROL_DMACTIVE);
+	}
+
+	uint32_t dmstatus = riscv_batch_get_dmi_read_data(batch, dmstatus_read);
+	if (get_field(dmstatus, DM_DMSTATUS_ANYUNAVAIL) ||
+			get_field(dmstatus, DM_DMSTATUS_ANYNONEXISTENT) ||
+			get_field(dmstatus, DM_DMSTATUS_ANYHAVERESET)) {
+		LOG_DEBUG("dmstatus=0x%08x; polling harts one at a time.", dmstatus);
+		return ERROR_OK;
+	}
+
+	for (unsigned i = 0; i < window_count; i++)
+		dm->haltsum[i] = riscv_batch_get_dmi_read_data(batch, haltsum_read[i]);
+	dm->halted_sampled = true;
+	return ERROR_OK;
+}
+
+static int riscv013_poll_halted(struct target *target, unsigned poll_id,
+		int hartid, bool *halted)
+{
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+	/* Reading a single hart's dmstatus is cheaper. */
+	if (!dm->hasel_supported || dm->hart_count <= 1)
+		return ERROR_FAIL;
+
+	if (dm->halted_poll_id != poll_id) {
+		dm->halted_poll_id = poll_id;
+		if (sample_halted_harts(target) != ERROR_OK)
+			return ERROR_FAIL;
+	}
+	if (!dm->halted_sampled)
+		return ERROR_FAIL;
+
+	*halted = (dm->haltsum[hartid / 32] >> (hartid % 32)) & 1;
+	return ERROR_OK;
+}
+
 static int riscv013_halt_prep(struct target *target)
 {
 	return ERROR_OK;
@@ -203,6 +203,8 @@ int riscv_command_timeout_sec = DEFAULT_COMMAND_TIMEOUT_SEC;
 int riscv_reset_timeout_sec = DEFAULT_RESET_TIMEOUT_SEC;
 
 bool riscv_prefer_sba;
+bool riscv_prefer_sba_set;
+bool riscv_calibrate_mem_access;
 bool riscv_enable_virt2phys = true;
 bool riscv_ebreakm = true;
 bool riscv_ebreaks = true;
@@ -267,6 +269,7 @@ virt2phys_info_t sv48 = {
 };
 
 static int riscv_resume_go_all_harts(struct target *target);
+static bool gdb_regno_cacheable(enum gdb_regno regno, bool write);
 
 void select_dmi_via_bscan(struct target *target)
 {
@@ -1435,6 +1438,60 @@ static int riscv_mmu(struct target *target, int *enabled)
 	return ERROR_OK;
 }
 
+void riscv_invalidate_tlb(struct target *target, int hartid)
+{
+	RISCV_INFO(r);
+	for (unsigned i = 0; i < RISCV_TLB_SIZE; i++) {
+		if (hartid < 0 || r->tlb[i].hartid == hartid)
+			r->tlb[i].valid = false;
+	}
+}
+
+/* A memory write may change page tables, which the harts of an SMP group
+ * share, so clear the TLB of every one of them. */
+static void riscv_invalidate_smp_tlb(struct target *target)
+{
+	if (!target->smp) {
+		riscv_invalidate_tlb(target, -1);
+		return;
+	}
+	for (struct target_list *tlist = target->head; tlist; tlist = tlist->next)
+		riscv_invalidate_tlb(tlist->target, -1);
+}
+
+static bool riscv_tlb_lookup(struct target *target, riscv_reg_t satp,
+		target_addr_t virtual, target_addr_t *physical)
+{
+	RISCV_INFO(r);
+	int hartid = riscv_current_hartid(target);
+	for (unsigned i = 0; i < RISCV_TLB_SIZE; i++) {
+		riscv_tlb_entry_t *entry = &r->tlb[i];
+		if (!entry->valid || entry->hartid != hartid || entry->satp != satp ||
+				(virtual >> entry->page_shift) != (entry->virtual >> entry->page_shift))
+			continue;
+		target_addr_t offset_mask = ((target_addr_t)1 << entry->page_shift) - 1;
+		*physical = entry->physical | (virtual & offset_mask);
+		return true;
+	}
+	return false;
+}
+
+static void riscv_tlb_insert(struct target *target, riscv_reg_t satp,
+		target_addr_t virtual, target_addr_t physical, unsigned page_shift)
+{
+	RISCV_INFO(r);
+	target_addr_t offset_mask = ((target_addr_t)1 << page_shift) - 1;
+	riscv_tlb_entry_t *entry = &r->tlb[r->tlb_next];
+	r->tlb_next = (r->tlb_next + 1) % RISCV_TLB_SIZE;
+
+	entry->valid = true;
+	entry->hartid = riscv_current_hartid(target);
+	entry->satp = satp;
+	entry->virtual = virtual & ~offset_mask;
+	entry->physical = physical & ~offset_mask;
+	entry->page_shift = page_shift;
+}
+
 static int riscv_address_translate(struct target *target,
 		target_addr_t virtual, target_addr_t *physical)
 {
@@ -1486,6 +1543,14 @@ static int riscv_address_translate(struct target *target,
 		return ERROR_FAIL;
 	}
 
+	if (riscv_tlb_lookup(target, satp_value, virtual, physical)) {
+		r->tlb_hits++;
+		LOG_DEBUG("0x%" TARGET_PRIxADDR " -> 0x%" TARGET_PRIxADDR " (cached)",
+				virtual, *physical);
+		return ERROR_OK;
+	}
+	r->tlb_misses++;
+
 	ppn_value = get_field(satp_value, RISCV_SATP_PPN(xlen));
 	table_address = ppn_value << RISCV_PGSHIFT;
 	i = info->level - 1;
@@ -1530,6 +1595,7 @@ static int riscv_address_translate(struct target *target,
 	/* Make sure to clear out the high bits that may be set. */
 	*physical = virtual & (((target_addr_t)1 << info->va_bits) - 1);
 
+	unsigned page_shift = info->pa_ppn_shift[i];
 	while (i < info->level) {
 		ppn_value = pte >> info->pte_ppn_shift[i];
 		ppn_value &= info->pte_ppn_mask[i];
@@ -1541,6 +1607,7 @@ static int riscv_address_translate(struct target *target,
 	LOG_DEBUG("0x%" TARGET_PRIxADDR " -> 0x%" TARGET_PRIxADDR, virtual,
 			*physical);
 
+	riscv_tlb_insert(target, satp_value, virtual, *physical, page_shift);
 	return ERROR_OK;
 }
 
@@ -1591,6 +1658,8 @@ static int riscv_write_phys_memory(struct target *target, target_addr_t phys_add
 {
 	if (riscv_select_current_hart(target) != ERROR_OK)
 		return ERROR_FAIL;
+	/* The write may change page tables. */
+	riscv_invalidate_smp_tlb(target);
 	struct target_type *tt = get_target_type(target);
 	return tt->write_memory(target, phys_address, size, count, buffer);
 }
@@ -1610,10 +1679,66 @@ static int riscv_write_memory(struct target *target, target_addr_t address,
 	if (target->type->virt2phys(target, address, &physical_addr) == ERROR_OK)
 		address = physical_addr;
 
+	/* The write may change page tables. */
+	riscv_invalidate_smp_tlb(target);
+
 	struct target_type *tt = get_target_type(target);
 	return tt->write_memory(target, address, size, count, buffer);
 }
 
+/* Fill the register cache with as many of the first count registers as the
+ * target can read at once. Whatever is left is read one at a time. */
+static void riscv_read_registers_at_once(struct target *target,
+		unsigned count)
+{
+	RISCV_INFO(r);
+	int hartid = riscv_current_hartid(target);
+	bool rve = riscv_supports_extension(target, hartid, 'E');
+	int regids[count];
+	unsigned n = 0;
+	int vregids[32];
+	uint8_t *vbufs[32];
+	unsigned vn = 0;
+	for (unsigned i = 0; i < count; i++) {
+		struct reg *reg = &target->reg_cache->reg_list[i];
+		if (!reg->exist || reg->valid)
+			continue;
+		if (i <= GDB_REGNO_XPR31) {
+			if (!rve || i <= GDB_REGNO_XPR15)
+				regids[n++] = i;
+		} else if (i == GDB_REGNO_PC ||
+				(i >= GDB_REGNO_FPR0 && i <= GDB_REGNO_FPR31)) {
+			regids[n++] = i;
+		} else if (i >= GDB_REGNO_V0 && i <= GDB_REGNO_V31) {
+			vregids[vn] = i;
+			vbufs[vn++] = reg->value;
+		}
+	}
+
+	riscv_reg_t values[MAX(n, 1)];
+	if (n > 1 && r->get_registers) {
+		if (r->get_registers(target, hartid, n, regids, values) == ERROR_OK) {
+			for (unsigned i = 0; i < n; i++) {
+				struct reg *reg = &target->reg_cache->reg_list[regids[i]];
+				buf_set_u64(reg->value, 0, reg->size, values[i]);
+				reg->valid = gdb_regno_cacheable(regids[i], false);
+			}
+		} else {
+			LOG_DEBUG("Reading %d registers one at a time.", n);
+		}
+	}
+
+	if (vn > 1 && r->get_register_bufs) {
+		if (r->get_register_bufs(target, vn, vregids, vbufs) == ERROR_OK) {
+			for (unsigned i = 0; i < vn; i++)
+				target->reg_cache->reg_list[vregids[i]].valid =
+					gdb_regno_cacheable(vregids[i], false);
+		} else {
+			LOG_DEBUG("Reading %d vector registers one at a time.", vn);
+		}
+	}
+}
+
 static int riscv_get_gdb_reg_list_internal(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class, bool read)
@@ -1646,6 +1771,9 @@ static int riscv_get_gdb_reg_list_internal(struct target *target,
 	if (!*reg_list)
 		return ERROR_FAIL;
 
+	if (read)
+		riscv_read_registers_at_once(target, *reg_list_size);
+
 	for (int i = 0; i < *reg_list_size; i++) {
 		assert(!target->reg_cache->reg_list[i].valid ||
 				target->reg_cache->reg_list[i].size > 0);
@@ -1941,19 +2069,28 @@ enum riscv_poll_hart {
 	RPH_DISCOVERED_RUNNING,
 	RPH_ERROR
 };
-static enum riscv_poll_hart riscv_poll_hart(struct target *target, int hartid)
+/* poll_id identifies the poll cycle, so the halted state of all the harts can
+ * be read once per cycle. 0 polls the hart on its own. */
+static enum riscv_poll_hart riscv_poll_hart(struct target *target, int hartid,
+		unsigned poll_id)
 {
 	RISCV_INFO(r);
-	if (riscv_set_current_hartid(target, hartid) != ERROR_OK)
-		return RPH_ERROR;
-
 	LOG_DEBUG("polling hart %d, target->state=%d", hartid, target->state);
 
+	bool halted;
+	if (!poll_id || !r->poll_halted ||
+			r->poll_halted(target, poll_id, hartid, &halted) != ERROR_OK) {
+		if (riscv_set_current_hartid(target, hartid) != ERROR_OK)
+			return RPH_ERROR;
+		halted = riscv_is_halted(target);
+	}
+
 	/* If OpenOCD thinks we're running but this hart is halted then it's time
 	 * to raise an event. */
-	bool halted = riscv_is_halted(target);
 	if (target->state != TARGET_HALTED && halted) {
 		LOG_DEBUG("  triggered a halt");
+		if (riscv_set_current_hartid(target, hartid) != ERROR_OK)
+			return RPH_ERROR;
 		r->on_halt(target);
 		return RPH_DISCOVERED_HALTED;
 	} else if (target->state != TARGET_RUNNING && !halted) {
@@ -2000,7 +2137,7 @@ int riscv_openocd_poll(struct target *target)
 	if (riscv_rtos_enabled(target)) {
 		/* Check every hart for an event. */
 		for (int i = 0; i < riscv_count_harts(target); ++i) {
-			enum riscv_poll_hart out = riscv_poll_hart(target, i);
+			enum riscv_poll_hart out = riscv_poll_hart(target, i, 0);
 			switch (out) {
 			case RPH_NO_CHANGE:
 			case RPH_DISCOVERED_RUNNING:
@@ -2041,12 +2178,17 @@ int riscv_openocd_poll(struct target *target)
 		unsigned should_remain_halted = 0;
 		unsigned should_resume = 0;
 		unsigned i = 0;
+		/* Harts sharing a DM get their halted state read together. */
+		static unsigned poll_id;
+		if (++poll_id == 0)
+			poll_id = 1;
 		for (struct target_list *list = target->head; list != NULL;
 				list = list->next, i++) {
 			total_targets++;
 			struct target *t = list->target;
 			riscv_info_t *r = riscv_info(t);
-			enum riscv_poll_hart out = riscv_poll_hart(t, r->current_hartid);
+			enum riscv_poll_hart out = riscv_poll_hart(t, r->current_hartid,
+					poll_id);
 			switch (out) {
 			case RPH_NO_CHANGE:
 				break;
@@ -2105,7 +2247,7 @@ int riscv_openocd_poll(struct target *target)
 
 	} else {
 		enum riscv_poll_hart out = riscv_poll_hart(target,
-				riscv_current_hartid(target));
+				riscv_current_hartid(target), 0);
 		if (out == RPH_NO_CHANGE || out == RPH_DISCOVERED_RUNNING)
 			return ERROR_OK;
 		else if (out == RPH_ERROR)
@@ -2232,6 +2374,17 @@ COMMAND_HANDLER(riscv_set_prefer_sba)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	}
 	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], riscv_prefer_sba);
+	riscv_prefer_sba_set = true;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(riscv_set_calibrate_mem_access)
+{
+	if (CMD_ARGC != 1) {
+		LOG_ERROR("Command takes exactly 1 parameter");
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], riscv_calibrate_mem_access);
 	return ERROR_OK;
 }
 
@@ -2480,6 +2633,52 @@ COMMAND_HANDLER(riscv_test_sba_config_reg)
 	}
 }
 
+COMMAND_HANDLER(riscv_mem_access_methods)
+{
+	if (CMD_ARGC != 0) {
+		LOG_ERROR("Command takes no arguments");
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (r->print_mem_access_methods) {
+		return r->print_mem_access_methods(target, CMD);
+	} else {
+		LOG_ERROR("mem_access_methods is not implemented for this target.");
+		return ERROR_FAIL;
+	}
+}
+
+COMMAND_HANDLER(riscv_tlb_stats)
+{
+	if (CMD_ARGC > 1) {
+		LOG_ERROR("Command takes at most one argument");
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		r->tlb_hits = 0;
+		r->tlb_misses = 0;
+		return ERROR_OK;
+	}
+
+	unsigned valid = 0;
+	for (unsigned i = 0; i < RISCV_TLB_SIZE; i++) {
+		if (r->tlb[i].valid)
+			valid++;
+	}
+	command_print(CMD, "%llu hits, %llu misses, %u/%u entries valid",
+			r->tlb_hits, r->tlb_misses, valid, RISCV_TLB_SIZE);
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(riscv_reset_delays)
 {
 	int wait = 0;
@@ -2635,6 +2834,24 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 		.help = "When on, prefer to use System Bus Access to access memory. "
 			"When off (default), prefer to use the Program Buffer to access memory."
 	},
+	{
+		.name = "set_calibrate_mem_access",
+		.handler = riscv_set_calibrate_mem_access,
+		.mode = COMMAND_ANY,
+		.usage = "on|off",
+		.help = "When on, measure the memory access methods on the work area "
+			"when the target is examined, and use the fastest. Off by default, "
+			"since System Bus Access bypasses the caches of the hart."
+	},
+	{
+		.name = "mem_access_methods",
+		.handler = riscv_mem_access_methods,
+		.mode = COMMAND_EXEC,
+		.usage = "",
+		.help = "Show the memory access method used for each access size, "
+			"and the rates measured for each method when the target was "
+			"examined."
+	},
 	{
 		.name = "set_enable_virtual",
 		.handler = riscv_set_enable_virtual,
@@ -2740,6 +2957,14 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 			"(optional) to indicate Bscan Tunnel Type {0:(default) NESTED_TAP , "
 			"1: DATA_REGISTER}"
 	},
+	{
+		.name = "tlb_stats",
+		.handler = riscv_tlb_stats,
+		.mode = COMMAND_ANY,
+		.usage = "[reset]",
+		.help = "Show how often virtual address translations were found in "
+			"the software TLB, or reset those counters."
+	},
 	{
 		.name = "set_enable_virt2phys",
 		.handler = riscv_set_enable_virt2phys,
@@ -3018,6 +3243,7 @@ void riscv_invalidate_register_cache(struct target *target)
 		struct reg *reg = &target->reg_cache->reg_list[i];
 		reg->valid = false;
 	}
+	riscv_invalidate_tlb(target, -1);
 
 	r->registers_initialized = true;
 }
@@ -3129,6 +3355,9 @@ int riscv_set_register_on_hart(struct target *target, int hartid,
 	struct reg *reg = &target->reg_cache->reg_list[regid];
 	buf_set_u64(reg->value, 0, reg->size, value);
 
+	if (regid == GDB_REGNO_SATP)
+		riscv_invalidate_tlb(target, hartid);
+
 	int result = r->set_register(target, hartid, regid, value);
 	if (result == ERROR_OK)
 		reg->valid = gdb_regno_cacheable(regid, true);
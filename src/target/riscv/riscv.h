@@ -16,6 +16,7 @@ struct riscv_program;
 #define RISCV_MAX_REGISTERS 5000
 #define RISCV_MAX_TRIGGERS 32
 #define RISCV_MAX_HWBPS 16
+#define RISCV_TLB_SIZE 16
 
 #define DEFAULT_COMMAND_TIMEOUT_SEC		2
 #define DEFAULT_RESET_TIMEOUT_SEC		30
@@ -51,6 +52,18 @@ typedef struct {
 	unsigned custom_number;
 } riscv_reg_info_t;
 
+/* A page translation cached by riscv_address_translate(). */
+typedef struct {
+	bool valid;
+	/* The hart and the value of its satp the translation was made for. */
+	int hartid;
+	riscv_reg_t satp;
+	/* The virtual and physical address of the page, and its size. */
+	target_addr_t virtual;
+	target_addr_t physical;
+	unsigned page_shift;
+} riscv_tlb_entry_t;
+
 typedef struct {
 	unsigned dtm_version;
 
@@ -116,11 +129,23 @@ typedef struct {
 		riscv_reg_t *value, int hid, int rid);
 	int (*set_register)(struct target *target, int hartid, int regid,
 			uint64_t value);
+	/* Read count registers of a hart at once. Either all of them are read or
+	 * ERROR_FAIL is returned. Optional. */
+	int (*get_registers)(struct target *target, int hartid, unsigned count,
+			const int *regids, riscv_reg_t *values);
 	int (*get_register_buf)(struct target *target, uint8_t *buf, int regno);
+	/* Read count vector registers in one go. Optional. */
+	int (*get_register_bufs)(struct target *target, unsigned count,
+			const int *regids, uint8_t **bufs);
 	int (*set_register_buf)(struct target *target, int regno,
 			const uint8_t *buf);
 	int (*select_current_hart)(struct target *target);
 	bool (*is_halted)(struct target *target);
+	/* Tell whether a hart is halted from the state of all the harts on its
+	 * DM, which is read in one go once per poll_id. Return ERROR_FAIL when
+	 * the hart has to be polled on its own instead. Optional. */
+	int (*poll_halted)(struct target *target, unsigned poll_id, int hartid,
+			bool *halted);
 	/* Resume this target, as well as every other prepped target that can be
 	 * resumed near-simultaneously. Clear the prepped flag on any target that
 	 * was resumed. */
@@ -154,6 +179,11 @@ typedef struct {
 
 	int (*test_compliance)(struct target *target);
 
+	/* Print the memory access method used for each access size, and the
+	 * rates measured for each method. */
+	int (*print_mem_access_methods)(struct target *target,
+			struct command_invocation *cmd);
+
 	int (*read_memory)(struct target *target, target_addr_t address,
 			uint32_t size, uint32_t count, uint8_t *buffer, uint32_t increment);
 
@@ -179,6 +209,14 @@ typedef struct {
 	/* Set when trigger registers are changed by the user. This indicates we eed
 	 * to beware that we may hit a trigger that we didn't realize had been set. */
 	bool manual_hwbp_set;
+
+	/* Translations cached by riscv_address_translate(), so repeated accesses
+	 * to the same pages don't walk the page tables again. Replaced round
+	 * robin, starting at tlb_next. */
+	riscv_tlb_entry_t tlb[RISCV_TLB_SIZE];
+	unsigned tlb_next;
+	unsigned long long tlb_hits;
+	unsigned long long tlb_misses;
 } riscv_info_t;
 
 typedef struct {
@@ -206,6 +244,10 @@ extern int riscv_command_timeout_sec;
 extern int riscv_reset_timeout_sec;
 
 extern bool riscv_prefer_sba;
+/* riscv set_prefer_sba was used, so memory access calibration is ignored */
+extern bool riscv_prefer_sba_set;
+/* riscv set_calibrate_mem_access: calibrate memory accesses at examine */
+extern bool riscv_calibrate_mem_access;
 
 extern bool riscv_enable_virtual;
 extern bool riscv_ebreakm;
@@ -329,6 +371,11 @@ int riscv_dmi_write_u64_bits(struct target *target);
 /* Invalidates the register cache. */
 void riscv_invalidate_register_cache(struct target *target);
 
+/* Invalidates the cached address translations of a hart, or of all the harts
+ * if hartid is -1. Needed whenever the page tables may have changed: when the
+ * harts ran (which covers sfence.vma), satp was written or memory written. */
+void riscv_invalidate_tlb(struct target *target, int hartid);
+
 /* Returns TRUE when a hart is enabled in this target. */
 bool riscv_hart_enabled(struct target *target, int hartid);
 
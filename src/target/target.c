@@ -55,6 +55,8 @@
 #include "rtos/rtos.h"
 #include "transport/transport.h"
 #include "arm_cti.h"
+#include "mem_cache.h"
+#include "smp.h"
 
 /* default halt wait timeout (ms) */
 #define DEFAULT_HALT_TIMEOUT 5000
@@ -154,6 +156,8 @@ static struct target_type *target_types[] = {
 struct target *all_targets;
 static struct target_event_callback *target_event_callbacks;
 static struct target_timer_callback *target_timer_callbacks;
+/* Time in ms at which the earliest timer callback is due */
+static int64_t target_timer_next_event_value;
 static LIST_HEAD(target_reset_callback_list);
 static LIST_HEAD(target_trace_callback_list);
 static const int polling_interval = 100;
@@ -590,6 +594,21 @@ int target_halt(struct target *target)
 	return ERROR_OK;
 }
 
+/* Tell the copies of target memory kept elsewhere, such as the GDB
+ * read-ahead, that the memory may have changed. The cores of an SMP group
+ * share their memory, so all of them are told. */
+static void target_mem_epoch_bump(struct target *target)
+{
+	if (!target->smp) {
+		target->mem_epoch++;
+		return;
+	}
+
+	struct target_list *head;
+	foreach_smp_target(head, target->head)
+		head->target->mem_epoch++;
+}
+
 /**
  * Make the target (re)start executing using its saved execution
  * context (possibly with some modifications).
@@ -633,6 +652,9 @@ int target_resume(struct target *target, int current, target_addr_t address,
 
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_START);
 
+	target_mem_cache_invalidate(target);
+	target_mem_epoch_bump(target);
+
 	/* note that resume *must* be asynchronous. The CPU can halt before
 	 * we poll. The CPU can even halt at the current PC as a result of
 	 * a software breakpoint being inserted by (a bug?) the application.
@@ -669,8 +691,11 @@ static int target_process_reset(struct command_invocation *cmd, enum target_rese
 	}
 
 	struct target *target;
-	for (target = all_targets; target; target = target->next)
+	for (target = all_targets; target; target = target->next) {
 		target_call_reset_callbacks(target, reset_mode);
+		target_mem_cache_invalidate(target);
+		target_mem_epoch_bump(target);
+	}
 
 	/* disable polling during reset to make reset event scripts
 	 * more predictable, i.e. dr/irscan & pathmove in events will
@@ -697,6 +722,8 @@ static int target_process_reset(struct command_invocation *cmd, enum target_rese
 	for (target = all_targets; target; target = target->next) {
 		target->type->check_reset(target);
 		target->running_alg = false;
+		target_mem_cache_invalidate(target);
+		target_mem_epoch_bump(target);
 	}
 
 	return retval;
@@ -841,6 +868,8 @@ int target_run_algorithm(struct target *target,
 		goto done;
 	}
 
+	target_mem_cache_invalidate(target);
+	target_mem_epoch_bump(target);
 	target->running_alg = true;
 	retval = target->type->run_algorithm(target,
 			num_mem_params, mem_params,
@@ -886,6 +915,8 @@ int target_start_algorithm(struct target *target,
 		goto done;
 	}
 
+	target_mem_cache_invalidate(target);
+	target_mem_epoch_bump(target);
 	target->running_alg = true;
 	retval = target->type->start_algorithm(target,
 			num_mem_params, mem_params,
@@ -930,6 +961,8 @@ int target_wait_algorithm(struct target *target,
 			num_mem_params, mem_params,
 			num_reg_params, reg_params,
 			exit_point, timeout_ms, arch_info);
+	target_mem_cache_invalidate(target);
+	target_mem_epoch_bump(target);
 	if (retval != ERROR_TARGET_TIMEOUT)
 		target->running_alg = false;
 
@@ -1294,6 +1327,8 @@ int target_read_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	if (target->mem_cache)
+		return target_mem_cache_read(target, address, size, count, buffer);
 	return target->type->read_memory(target, address, size, count, buffer);
 }
 
@@ -1322,7 +1357,13 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
-	return target->type->write_memory(target, address, size, count, buffer);
+	int retval = target->type->write_memory(target, address, size, count, buffer);
+	if (retval == ERROR_OK)
+		target_mem_cache_write(target, address, size, count, buffer);
+	else
+		target_mem_cache_invalidate(target);
+	target_mem_epoch_bump(target);
+	return retval;
 }
 
 int target_write_phys_memory(struct target *target,
@@ -1336,6 +1377,9 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	/* The cache holds virtual addresses, which may alias the physical ones */
+	target_mem_cache_invalidate(target);
+	target_mem_epoch_bump(target);
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1463,6 +1507,9 @@ int target_step(struct target *target,
 
 	target_call_event_callbacks(target, TARGET_EVENT_STEP_START);
 
+	target_mem_cache_invalidate(target);
+	target_mem_epoch_bump(target);
+
 	retval = target->type->step(target, current, address, handle_breakpoints);
 	if (retval != ERROR_OK)
 		return retval;
@@ -1739,6 +1786,10 @@ int target_register_timer_callback(int (*callback)(void *priv),
 	(*callbacks_p)->priv = priv;
 	(*callbacks_p)->next = NULL;
 
+	int64_t when_ms = timeval_ms() + time_ms;
+	if (when_ms < target_timer_next_event_value)
+		target_timer_next_event_value = when_ms;
+
 	return ERROR_OK;
 }
 
@@ -1824,6 +1875,21 @@ int target_call_event_callbacks(struct target *target, enum target_event event)
 	struct target_event_callback *callback = target_event_callbacks;
 	struct target_event_callback *next_callback;
 
+	switch (event) {
+		case TARGET_EVENT_HALTED:
+		case TARGET_EVENT_RESUMED:
+		case TARGET_EVENT_RESET_ASSERT:
+		case TARGET_EVENT_GDB_FLASH_ERASE_END:
+		case TARGET_EVENT_GDB_FLASH_WRITE_END:
+			/* The target may have run, or its memory changed, since the
+			 * memory cache and other copies were filled */
+			target_mem_cache_invalidate(target);
+			target_mem_epoch_bump(target);
+			break;
+		default:
+			break;
+	}
+
 	if (event == TARGET_EVENT_HALTED) {
 		/* execute early halted first */
 		target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
@@ -1894,13 +1960,21 @@ static int target_call_timer_callbacks_check_time(int checktime)
 	if (callback_processing)
 		return ERROR_OK;
 
-	callback_processing = true;
-
 	keep_alive();
 
 	struct timeval now;
 	gettimeofday(&now, NULL);
 
+	/* Nothing is due yet, no need to look at every callback */
+	if (checktime && (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000 <
+			target_timer_next_event_value)
+		return ERROR_OK;
+
+	callback_processing = true;
+
+	/* Callbacks registered from the callbacks below lower this again */
+	target_timer_next_event_value = INT64_MAX;
+
 	/* Store an address of the place containing a pointer to the
 	 * next item; initially, that's a standalone "root of the
 	 * list" variable. */
@@ -1920,6 +1994,13 @@ static int target_call_timer_callbacks_check_time(int checktime)
 		if (call_it)
 			target_call_timer_callback(*callback, &now);
 
+		if (!(*callback)->removed) {
+			int64_t when_ms = (int64_t)(*callback)->when.tv_sec * 1000 +
+				(*callback)->when.tv_usec / 1000;
+			if (when_ms < target_timer_next_event_value)
+				target_timer_next_event_value = when_ms;
+		}
+
 		callback = &(*callback)->next;
 	}
 
@@ -1927,6 +2008,11 @@ static int target_call_timer_callbacks_check_time(int checktime)
 	return ERROR_OK;
 }
 
+int64_t target_timer_next_event(void)
+{
+	return target_timer_next_event_value;
+}
+
 int target_call_timer_callbacks(void)
 {
 	return target_call_timer_callbacks_check_time(1);
@@ -2261,6 +2347,8 @@ static void target_destroy(struct target *target)
 
 	rtos_destroy(target);
 
+	target_mem_cache_free(target);
+
 	free(target->gdb_port_override);
 	free(target->type);
 	free(target->trace_info);
@@ -2402,7 +2490,18 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
-	return target->type->write_buffer(target, address, size, buffer);
+	if (target->type->write_buffer == target_write_buffer_default)
+		return target_write_buffer_default(target, address, size, buffer);
+
+	/* Target specific versions, such as those of nds32 and dsp5680xx, don't
+	 * go through target_write_memory() and its memory cache update */
+	int retval = target->type->write_buffer(target, address, size, buffer);
+	if (retval == ERROR_OK)
+		target_mem_cache_write(target, address, 1, size, buffer);
+	else
+		target_mem_cache_invalidate(target);
+	target_mem_epoch_bump(target);
+	return retval;
 }
 
 static int target_write_buffer_default(struct target *target,
@@ -5870,6 +5969,9 @@ static int target_create(struct jim_getopt_info *goi)
 		{
 			.chain = target_instance_command_handlers,
 		},
+		{
+			.chain = mem_cache_command_handlers,
+		},
 		{
 			.chain = target->type->commands,
 		},
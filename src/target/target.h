@@ -217,6 +217,12 @@ struct target {
 
 	/* The semihosting information, extracted from the target. */
 	struct semihosting *semihosting;
+
+	/* Memory read cache while halted, see mem_cache.h */
+	struct target_mem_cache *mem_cache;
+	/* Bumped whenever the target memory may have changed, so that copies
+	 * of it kept elsewhere, such as GDB read-ahead, can be dropped */
+	uint64_t mem_epoch;
 };
 
 struct target_list {
@@ -407,6 +413,11 @@ int target_call_timer_callbacks(void);
  * a synchronous command completes.
  */
 int target_call_timer_callbacks_now(void);
+/**
+ * Returns the time in ms, as from timeval_ms(), at which the next timer
+ * callback is due.
+ */
+int64_t target_timer_next_event(void);
 
 struct target *get_target_by_num(int num);
 struct target *get_current_target(struct command_context *cmd_ctx);
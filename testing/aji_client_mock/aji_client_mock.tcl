@@ -0,0 +1,15 @@
+# Common setup of the tests run against the simulated JTAG server.
+
+adapter driver aji_client
+
+gdb_port disabled
+telnet_port disabled
+tcl_port disabled
+
+# Fail the test, which makes OpenOCD exit with an error, unless got is want
+proc expect {what got want} {
+	if {$got != $want} {
+		error "$what is $got, expected $want"
+	}
+	echo "$what is $got"
+}